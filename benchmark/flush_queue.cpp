@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////
+// Module includes.
+////////////////////////////////////////////////////////////////
+
+#include "logandload/log/log.h"
+
+/*
+ * Measures how the flush path of a Log scales with the number of threads. Each thread writes messages to its own
+ * stream. Stream buffers are small, so that streams flush after a few messages and the time is dominated by handing
+ * buffers to the processor thread. Only the public Log and Stream interface is used, so the same source can be built
+ * against older versions of the library for comparison.
+ *
+ * Usage: logandload_benchmark [max threads] [messages per thread] [stream buffer size]
+ */
+
+namespace
+{
+    struct BenchmarkFormat
+    {
+        static constexpr char     message[] = "thread {} message {}";
+        static constexpr uint32_t category  = 0;
+    };
+
+    using log_t = lal::Log<lal::CategoryFilterNone, lal::Ordering::Disabled>;
+
+    /**
+     * \brief Write messages from a number of threads to a log.
+     * \param path Path to log file.
+     * \param threads Number of threads.
+     * \param messages Number of messages per thread.
+     * \param streamSize Size of the buffer of each stream in bytes.
+     * \return Messages per second, including the time to write remaining data when the log is destroyed.
+     */
+    double run(const std::filesystem::path& path, const size_t threads, const size_t messages, const size_t streamSize)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        {
+            log_t                     log(path, 1024 * 1024);
+            std::vector<std::jthread> writers;
+            for (size_t i = 0; i < threads; i++)
+            {
+                auto& stream = log.createStream(streamSize);
+                writers.emplace_back([&stream, i, messages] {
+                    for (size_t j = 0; j < messages; j++)
+                        stream.message<BenchmarkFormat>(static_cast<uint32_t>(i), static_cast<uint32_t>(j));
+                });
+            }
+        }
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        return static_cast<double>(threads * messages) / elapsed;
+    }
+}  // namespace
+
+int main(const int argc, char** argv)
+{
+    const size_t maxThreads = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : std::thread::hardware_concurrency();
+    const size_t messages   = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+    const size_t streamSize = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 256;
+
+    const auto path = std::filesystem::temp_directory_path() / "logandload_benchmark.bin";
+    auto       fmt  = path;
+    fmt += ".fmt";
+
+    std::cout << std::format("{:>8} {:>16} {:>16}\n", "threads", "messages [1/s]", "per thread [1/s]");
+    for (size_t threads = 1; threads <= std::max<size_t>(maxThreads, 1); threads *= 2)
+    {
+        const auto rate = run(path, threads, messages, streamSize);
+        std::cout << std::format("{:>8} {:>16.0f} {:>16.0f}\n", threads, rate, rate / static_cast<double>(threads));
+    }
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(fmt);
+
+    return 0;
+}
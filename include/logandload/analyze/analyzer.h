@@ -4,7 +4,10 @@
 // Standard includes.
 ////////////////////////////////////////////////////////////////
 
+#include <cstddef>
 #include <filesystem>
+#include <memory>
+#include <span>
 #include <unordered_map>
 #include <vector>
 
@@ -15,7 +18,10 @@
 #include "logandload/analyze/fmt_type.h"
 #include "logandload/analyze/node.h"
 #include "logandload/log/format_type.h"
+#include "logandload/log/ordering.h"
+#include "logandload/log/timestamps.h"
 #include "logandload/utils/lal_error.h"
+#include "logandload/utils/mapped_input_file.h"
 
 namespace lal
 {
@@ -48,6 +54,24 @@ namespace lal
 
         [[nodiscard]] size_t getStreamCount() const noexcept;
 
+        /**
+         * \brief Get the total number of messages that streams dropped because the log could not keep up.
+         * \return Count.
+         */
+        [[nodiscard]] uint64_t getDroppedCount() const noexcept;
+
+        /**
+         * \brief Get the total number of messages that were suppressed by sampling or rate limiting.
+         * \return Count.
+         */
+        [[nodiscard]] uint64_t getSuppressedCount() const noexcept;
+
+        /**
+         * \brief Get the timestamp calibration of the log. Source is Timestamps::Disabled if the log has no timestamps.
+         * \return Calibration.
+         */
+        [[nodiscard]] const Calibration& getCalibration() const noexcept;
+
         ////////////////////////////////////////////////////////////////
         // ...
         ////////////////////////////////////////////////////////////////
@@ -80,11 +104,35 @@ namespace lal
 
         std::unordered_map<MessageKey, FormatType> formatTypes;
 
+        /**
+         * \brief Format type of dropped nodes.
+         */
+        FormatType droppedType;
+
+        /**
+         * \brief Format type of suppressed nodes.
+         */
+        FormatType suppressedType;
+
+        uint64_t droppedCount = 0;
+
+        uint64_t suppressedCount = 0;
+
         size_t streamCount = 0;
 
-        bool messageOrder = false;
+        Ordering messageOrder = Ordering::Disabled;
+
+        Calibration calibration;
+
+        /**
+         * \brief Mapped log file. Nodes point into it, so it is kept open as long as the nodes.
+         */
+        std::unique_ptr<MappedInputFile> logFile;
 
-        std::vector<std::byte> data;
+        /**
+         * \brief Complete blocks of the mapped log file, including file header.
+         */
+        std::span<const std::byte> data;
 
         std::vector<Node> nodes;
     };
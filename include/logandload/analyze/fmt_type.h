@@ -4,6 +4,7 @@
 // Standard includes.
 ////////////////////////////////////////////////////////////////
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -56,6 +57,21 @@ namespace lal
          */
         [[nodiscard]] bool matches(const std::vector<ParameterKey>& params) const noexcept;
 
+        /**
+         * \brief Get the size of the parameter data of a message.
+         * \param data Pointer to parameter data.
+         * \return Size in bytes.
+         */
+        [[nodiscard]] size_t getSize(const std::byte* data) const noexcept;
+
+        /**
+         * \brief Get the offset of a parameter in the parameter data of a message.
+         * \param data Pointer to parameter data.
+         * \param index Parameter index.
+         * \return Offset in bytes.
+         */
+        [[nodiscard]] size_t getOffset(const std::byte* data, size_t index) const noexcept;
+
         ////////////////////////////////////////////////////////////////
         // Member variables.
         ////////////////////////////////////////////////////////////////
@@ -86,13 +102,23 @@ namespace lal
         std::vector<ParameterKey> parameters;
 
         /**
-         * \brief Size of each parameter in bytes.
+         * \brief Size of each parameter in bytes. 0 for variable-length parameters.
          */
         std::vector<size_t> parameterSize;
 
         /**
-         * \brief Sum of sizeof of all parameters.
+         * \brief For each parameter, whether it has a variable length, as stored in the format file.
+         */
+        std::vector<bool> variableParameters;
+
+        /**
+         * \brief Sum of sizeof of all parameters. Only valid if there are no variable-length parameters.
          */
         size_t messageSize = 0;
+
+        /**
+         * \brief True if any parameter has a variable length. Sizes must then be read from the parameter data.
+         */
+        bool variable = false;
     };
 }  // namespace lal
@@ -1,5 +1,13 @@
 #pragma once
 
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
 ////////////////////////////////////////////////////////////////
 // Current target includes.
 ////////////////////////////////////////////////////////////////
@@ -20,10 +28,12 @@ namespace lal
 
         enum class Type
         {
-            Log     = 1,
-            Stream  = 2,
-            Region  = 4,
-            Message = 8
+            Log        = 1,
+            Stream     = 2,
+            Region     = 4,
+            Message    = 8,
+            Dropped    = 16,
+            Suppressed = 32
         };
 
         ////////////////////////////////////////////////////////////////
@@ -48,6 +58,20 @@ namespace lal
 
         [[nodiscard]] size_t getIndex(const Analyzer& analyzer) const noexcept;
 
+        /**
+         * \brief Get the time of a message or the start of a region. Log should have timestamps.
+         * \param analyzer Analyzer.
+         * \return Wall-clock time in nanoseconds since the system clock epoch.
+         */
+        [[nodiscard]] int64_t getTime(const Analyzer& analyzer) const noexcept;
+
+        /**
+         * \brief Get the time of the end of a region. Log should have timestamps.
+         * \param analyzer Analyzer.
+         * \return Wall-clock time in nanoseconds since the system clock epoch.
+         */
+        [[nodiscard]] int64_t getEndTime(const Analyzer& analyzer) const noexcept;
+
         /**
          * \brief Returns whether this node holds a parameter of the given type at the given index.
          * \tparam T Parameter.
@@ -64,20 +88,29 @@ namespace lal
 
         /**
          * \brief Get the value of a parameter. Node should have a parameter of the given type at the given index.
+         * Variable-length parameters (std::string_view, std::span<const T>) are returned by value and refer to the
+         * data of the analyzer.
          * \tparam T Parameter type.
          * \param index Parameter index.
          * \return Value.
          */
         template<typename T>
-        [[nodiscard]] const T& get(const size_t index) const
+        [[nodiscard]] auto get(const size_t index) const -> std::conditional_t<is_variable_parameter_v<T>, T, const T&>
         {
             if (!has<T>(index)) throw LalError("Parameter type does not match.");
 
             // Sum size of preceding parameters.
-            size_t offset = 0;
-            for (size_t i = 0; i < index; i++) offset += formatType->parameterSize[i];
-
-            return *reinterpret_cast<const T*>(data + offset);
+            const auto* param = data + formatType->getOffset(data, index);
+
+            if constexpr (is_variable_parameter_v<T>)
+            {
+                using element_t   = std::remove_pointer_t<decltype(std::declval<T>().data())>;
+                const auto size   = *reinterpret_cast<const uint32_t*>(param);
+                const auto* first = reinterpret_cast<element_t*>(param + sizeof(uint32_t));
+                return T(first, size / sizeof(element_t));
+            }
+            else
+                return *reinterpret_cast<const T*>(param);
         }
 
         ////////////////////////////////////////////////////////////////
@@ -90,15 +123,26 @@ namespace lal
         Type type = Type::Log;
 
         /**
-         * \brief Format type.
+         * \brief Format type. For dropped nodes, parameters are the number of dropped messages and their size in bytes.
          */
         FormatType* formatType = nullptr;
 
         /**
-         * \brief Unique ordered index. Only used by messages if message ordering was enabled.
+         * \brief Unique ordered index. Only used by messages if message ordering was enabled. With timestamp ordering, it
+         * is reconstructed from the timestamps.
          */
         size_t index = 0;
 
+        /**
+         * \brief Raw timestamp of a message or region start. Only used if timestamps were enabled.
+         */
+        uint64_t timestamp = 0;
+
+        /**
+         * \brief Raw timestamp of a region end. Only used if timestamps were enabled.
+         */
+        uint64_t endTimestamp = 0;
+
         /**
          * \brief Parent node.
          */
@@ -117,6 +161,6 @@ namespace lal
         /**
          * \brief Pointer to parameter data.
          */
-        std::byte* data = nullptr;
+        const std::byte* data = nullptr;
     };
 }  // namespace lal
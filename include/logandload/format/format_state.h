@@ -17,18 +17,37 @@ namespace lal
     public:
         FormatState() = default;
 
-        FormatState(uint32_t indent, char character);
+        /**
+         * \brief Construct a format state.
+         * \param indent Number of characters by which each region is indented.
+         * \param character Indentation character.
+         * \param prefix Text at the start of each line, before the indentation.
+         */
+        FormatState(uint32_t indent, char character, std::string prefix = {});
 
         void pushRegion(std::string name);
 
         std::string popRegion();
 
+        /**
+         * \brief Check whether a region is open.
+         * \return True if there is a region to pop.
+         */
+        [[nodiscard]] bool hasRegion() const noexcept;
+
         std::string& getRegionPrepend();
 
+        /**
+         * \brief Get the position of the next message in the stream.
+         * \return Position.
+         */
+        size_t nextMessage();
+
     private:
         uint32_t                 indent    = 0;
         char                     character = ' ';
         std::vector<std::string> regionStack;
         std::string              regionPrepend;
+        size_t                   messageCount = 0;
     };
 }  // namespace lal
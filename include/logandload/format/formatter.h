@@ -5,19 +5,26 @@
 ////////////////////////////////////////////////////////////////
 
 #include <chrono>
+#include <cstddef>
 #include <filesystem>
 #include <fstream>
 #include <functional>
+#include <span>
+#include <stop_token>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 ////////////////////////////////////////////////////////////////
 // Current target includes.
 ////////////////////////////////////////////////////////////////
 
 #include "logandload/log/format_type.h"
+#include "logandload/log/ordering.h"
+#include "logandload/log/timestamps.h"
 #include "logandload/format/format_state.h"
 #include "logandload/format/message_formatter.h"
+#include "logandload/format/output_buffer.h"
 
 namespace lal
 {
@@ -57,71 +64,251 @@ namespace lal
 
         bool format(const std::filesystem::path& path);
 
+        /**
+         * \brief Format a log that is still being written, like tail -f. Complete blocks are formatted as they land,
+         * and appended to the output files. A partially written block is formatted once it is complete. The format
+         * file is reread when it grows. With timestamp ordering, messages are formatted without index.
+         * \param path Path to log file.
+         * \param token Stop token. After a stop was requested, all data written until then is formatted before
+         * returning.
+         * \param interval Time between polls.
+         * \return True.
+         */
+        bool follow(const std::filesystem::path& path,
+                    std::stop_token              token,
+                    std::chrono::milliseconds    interval = std::chrono::milliseconds(100));
+
     private:
         /**
-         * \brief Read a format file and construct a message formatter for each format type in the file.
+         * \brief Output of a stream. Each block is formatted into the buffer, which is then written to the file at once.
+         */
+        struct Output
+        {
+            Output(const std::filesystem::path& path, uint32_t indent, char character);
+
+            std::ofstream file;
+            OutputBuffer  buffer;
+            FormatState   state;
+        };
+
+        using OutputMap = std::unordered_map<size_t, Output>;
+
+        /**
+         * \brief Register parameter types with built-in formatting.
+         * \tparam T Parameter type.
+         * \tparam Ts Remaining parameter types.
+         */
+        template<typename T, typename... Ts>
+        void registerBuiltinParameter()
+        {
+            parameterFormatters.try_emplace(ParameterFormatter<T>::key, std::make_unique<ParameterFormatter<T>>());
+
+            // Recurse if there are types left.
+            if constexpr (sizeof...(Ts) > 0) registerBuiltinParameter<Ts...>();
+        }
+
+        /**
+         * \brief Read a format file and construct a message formatter for each format type in the file. Also reads the
+         * timestamp calibration.
          * \param fmtPath Path to format file.
-         * \return Map of message formatters.
+         * \return Message ordering and map of message formatters.
          */
-        std::pair<bool, MessageFormatterMap> createFormatters(const std::filesystem::path& fmtPath);
+        std::pair<Ordering, MessageFormatterMap> createFormatters(const std::filesystem::path& fmtPath);
 
         /**
          * \brief Read log file, format messages and write to one or more output files (one per stream in log).
          * \param path Path to log file.
-         * \param messageOrder Messages are ordered and include an index.
+         * \param messageOrder Message ordering.
+         * \param messageFormatters Map of message formatters.
+         */
+        void writeLog(const std::filesystem::path& path, Ordering messageOrder, MessageFormatterMap& messageFormatters);
+
+        /**
+         * \brief Format all complete blocks in the data.
+         * \param path Path to log file.
+         * \param data Blocks, starting at a block header.
+         * \param version Log file version.
+         * \param messageOrder Message ordering.
          * \param messageFormatters Map of message formatters.
+         * \param outputs Output file and format state per stream. Missing outputs are created.
+         * \param indices Per stream, the index of each message. Only used with timestamp ordering.
+         * \return Number of bytes that were formatted. Data after that is a partial block.
          */
-        void writeLog(const std::filesystem::path& path, bool messageOrder, MessageFormatterMap& messageFormatters);
+        [[nodiscard]] size_t writeBlocks(const std::filesystem::path&              path,
+                                         std::span<const std::byte>                data,
+                                         uint32_t                                  version,
+                                         Ordering                                  messageOrder,
+                                         MessageFormatterMap&                      messageFormatters,
+                                         OutputMap&                                outputs,
+                                         const std::vector<std::vector<uint64_t>>& indices);
 
         /**
-         * \brief Write an anonymous region start message to the output stream.
-         * \param out Output stream.
+         * \brief Format all complete blocks in the data with threadCount threads. Each stream is formatted by a single
+         * thread, so that the output is identical to writeBlocks.
+         * \param path Path to log file.
+         * \param data Blocks, starting at a block header. Shared by all threads.
+         * \param version Log file version.
+         * \param messageOrder Message ordering.
+         * \param messageFormatters Map of message formatters.
+         * \param indices Per stream, the index of each message. Only used with timestamp ordering.
+         */
+        void writeStreams(const std::filesystem::path&              path,
+                          std::span<const std::byte>                data,
+                          uint32_t                                  version,
+                          Ordering                                  messageOrder,
+                          MessageFormatterMap&                      messageFormatters,
+                          const std::vector<std::vector<uint64_t>>& indices);
+
+        /**
+         * \brief Format all complete blocks in the data into a single file, ordered by message index. Streams are
+         * merged while they are read, so only the blocks and the current position of each stream are kept in memory.
+         * With timestamp ordering, streams are merged by timestamp and the message index is counted while merging.
+         * \param path Path to log file.
+         * \param data Blocks, starting at a block header.
+         * \param version Log file version.
+         * \param messageOrder Message ordering. Must not be disabled.
+         * \param messageFormatters Map of message formatters.
+         */
+        void writeMerged(const std::filesystem::path& path,
+                         std::span<const std::byte>   data,
+                         uint32_t                     version,
+                         Ordering                     messageOrder,
+                         MessageFormatterMap&         messageFormatters);
+
+        /**
+         * \brief Format all messages in a block.
+         * \param block Block data, without header.
+         * \param streamIndex Stream index.
+         * \param messageOrder Message ordering.
+         * \param messageFormatters Map of message formatters.
+         * \param out Output buffer.
          * \param state State.
+         * \param indices Per stream, the index of each message. Only used with timestamp ordering.
          */
-        void writeAnonymousRegionStart(std::ostream& out, FormatState& state) const;
+        void writeBlock(std::span<const std::byte>                block,
+                        size_t                                    streamIndex,
+                        Ordering                                  messageOrder,
+                        MessageFormatterMap&                      messageFormatters,
+                        OutputBuffer&                             out,
+                        FormatState&                              state,
+                        const std::vector<std::vector<uint64_t>>& indices) const;
 
         /**
-         * \brief Write a named region start message to the output stream.
+         * \brief Format a single message or other record.
+         * \param in Input data, starting at the message key.
+         * \param messageOrder Message ordering.
          * \param messageFormatters Map of message formatters.
-         * \param in Input stream.
-         * \param out Output stream.
+         * \param out Output buffer.
          * \param state State.
+         * \param index Index of the record if it is a message. Only used with timestamp ordering, otherwise the index is
+         * read from the log.
+         * \return Pointer past the record.
+         */
+        const std::byte* writeRecord(const std::byte*     in,
+                                     Ordering             messageOrder,
+                                     MessageFormatterMap& messageFormatters,
+                                     OutputBuffer&        out,
+                                     FormatState&         state,
+                                     uint64_t             index) const;
+
+        /**
+         * \brief Read the timestamps of all messages in a log with timestamp ordering and reconstruct the message index.
+         * \param data Contents of log file.
+         * \param messageFormatters Map of message formatters.
+         * \return Per stream, the index of each message.
          */
-        void writeNamedRegionStart(MessageFormatterMap& messageFormatters,
-                                   std::istream&        in,
-                                   std::ostream&        out,
-                                   FormatState&         state) const;
+        std::vector<std::vector<uint64_t>> readOrder(std::span<const std::byte> data,
+                                                     MessageFormatterMap&       messageFormatters) const;
 
         /**
-         * \brief Write a region end message to the output stream.
-         * \param out Output stream.
+         * \brief Read a timestamp, if the log has them, and write it to the output buffer.
+         * \param in Input data.
+         * \param out Output buffer.
+         * \return Pointer past the timestamp.
+         */
+        const std::byte* writeTimestamp(const std::byte* in, OutputBuffer& out) const;
+
+        /**
+         * \brief Write an anonymous region start message to the output buffer.
+         * \param in Input data.
+         * \param out Output buffer.
          * \param state State.
+         * \return Pointer past the message.
          */
-        void writeRegionEnd(std::ostream& out, FormatState& state) const;
+        const std::byte* writeAnonymousRegionStart(const std::byte* in, OutputBuffer& out, FormatState& state) const;
 
         /**
-         * \brief Write a source information message to the output stream.
+         * \brief Write a named region start message to the output buffer.
          * \param messageFormatters Map of message formatters.
-         * \param in Input stream.
-         * \param out Output stream.
+         * \param in Input data.
+         * \param out Output buffer.
+         * \param state State.
+         * \return Pointer past the message.
          */
-        void writeSourceInfo(MessageFormatterMap& messageFormatters, std::istream& in, std::ostream& out);
+        const std::byte* writeNamedRegionStart(MessageFormatterMap& messageFormatters,
+                                               const std::byte*     in,
+                                               OutputBuffer&        out,
+                                               FormatState&         state) const;
 
         /**
-         * \brief  Write a formatted message to the output stream.
+         * \brief Write a region end message to the output buffer.
+         * \param in Input data.
+         * \param out Output buffer.
+         * \param state State.
+         * \return Pointer past the message.
+         */
+        const std::byte* writeRegionEnd(const std::byte* in, OutputBuffer& out, FormatState& state) const;
+
+        /**
+         * \brief Write a dropped messages record to the output buffer.
+         * \param in Input data.
+         * \param out Output buffer.
+         * \param state State.
+         * \return Pointer past the record.
+         */
+        const std::byte* writeDropped(const std::byte* in, OutputBuffer& out, FormatState& state) const;
+
+        /**
+         * \brief Write a suppressed messages record to the output buffer.
          * \param messageFormatters Map of message formatters.
-         * \param in Input stream.
-         * \param out Output stream.
+         * \param in Input data.
+         * \param out Output buffer.
+         * \param state State.
+         * \return Pointer past the record.
+         */
+        const std::byte* writeSuppressed(MessageFormatterMap& messageFormatters,
+                                         const std::byte*     in,
+                                         OutputBuffer&        out,
+                                         FormatState&         state) const;
+
+        /**
+         * \brief Write a source information message to the output buffer.
+         * \param messageFormatters Map of message formatters.
+         * \param in Input data.
+         * \param out Output buffer.
+         * \return Pointer past the message.
+         */
+        const std::byte*
+          writeSourceInfo(MessageFormatterMap& messageFormatters, const std::byte* in, OutputBuffer& out);
+
+        /**
+         * \brief  Write a formatted message to the output buffer.
+         * \param messageFormatters Map of message formatters.
+         * \param in Input data.
+         * \param out Output buffer.
          * \param key Message key.
          * \param state State.
-         * \param order If true, messages are ordered and message index must be read and written.
+         * \param order Message ordering. If enabled, message index must be read and written.
+         * \param index Reconstructed message index. Only used with timestamp ordering.
+         * \return Pointer past the message.
          */
-        void writeMessage(MessageFormatterMap& messageFormatters,
-                          std::istream&        in,
-                          std::ostream&        out,
-                          MessageKey           key,
-                          FormatState&         state,
-                          bool                 order) const;
+        const std::byte* writeMessage(MessageFormatterMap& messageFormatters,
+                                      const std::byte*     in,
+                                      OutputBuffer&        out,
+                                      MessageKey           key,
+                                      FormatState&         state,
+                                      Ordering             order,
+                                      uint64_t             index) const;
 
         ////////////////////////////////////////////////////////////////
         // Member variables.
@@ -129,12 +316,27 @@ namespace lal
 
         ParameterFormatterMap parameterFormatters;
 
+        /**
+         * \brief Timestamp calibration of the log that is being formatted.
+         */
+        Calibration calibration;
+
     public:
         /**
          * \brief Function for generating an output filename. First parameter is path to input log file. Second parameter is stream index.
          */
         std::function<std::filesystem::path(const std::filesystem::path&, size_t)> filenameFormatter;
 
+        /**
+         * \brief Function for generating the filename of merged output. Parameter is path to input log file.
+         */
+        std::function<std::filesystem::path(const std::filesystem::path&)> mergedFilenameFormatter;
+
+        /**
+         * \brief Function for writing the stream index at the start of each line of merged output.
+         */
+        std::function<void(std::ostream&, size_t)> streamFormatter;
+
         /**
          * \brief Function for writing the message category.
          */
@@ -155,6 +357,11 @@ namespace lal
          */
         char indexPaddingCharacter = '0';
 
+        /**
+         * \brief Function for writing the timestamp of messages and regions. Second parameter is the wall-clock time in nanoseconds since the system clock epoch.
+         */
+        std::function<void(std::ostream&, int64_t)> timestampFormatter;
+
         /**
          * \brief Function for writing anonymous regions. Second parameter indicates if a start (true) or end (false) region must be written.
          */
@@ -165,6 +372,16 @@ namespace lal
          */
         std::function<void(std::ostream&, bool, const std::string&)> namedRegionFormatter;
 
+        /**
+         * \brief Function for writing a gap left by dropped messages. Second and third parameter are the number of dropped messages and their size in bytes.
+         */
+        std::function<void(std::ostream&, uint64_t, uint64_t)> droppedFormatter;
+
+        /**
+         * \brief Function for writing the number of messages suppressed by sampling or rate limiting. Second and third parameter are the number of suppressed messages and their format string.
+         */
+        std::function<void(std::ostream&, uint64_t, const std::string&)> suppressedFormatter;
+
         /**
          * \brief Number of characters with which the default anonymousRegionFormatter and namedRegionFormatter pad a region.
          */
@@ -174,5 +391,15 @@ namespace lal
          * \brief Character with which the default anonymousRegionFormatter and namedRegionFormatter pad a region.
          */
         char regionIndentCharacter = ' ';
+
+        /**
+         * \brief Number of threads with which format() formats the streams of a log concurrently. Each stream is formatted by a single thread, so the output is the same as with 1 thread. 0 uses one thread per hardware thread. With more than 1 thread, all formatting functions must be safe to call concurrently.
+         */
+        uint32_t threadCount = 1;
+
+        /**
+         * \brief If true, format() writes the messages of all streams to a single file, ordered by message index, instead of one file per stream. Requires message ordering. Records without index, such as regions, are written right before the next message of their stream. With Ordering::Enabled, memory use does not grow with the number of messages. Not used by follow() and formatted by a single thread.
+         */
+        bool mergeStreams = false;
     };
 }  // namespace lal
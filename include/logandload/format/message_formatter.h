@@ -4,6 +4,7 @@
 // Standard includes.
 ////////////////////////////////////////////////////////////////
 
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -60,16 +61,25 @@ namespace lal
          */
         [[nodiscard]] uint32_t getCategory() const noexcept;
 
+
         ////////////////////////////////////////////////////////////////
         // Format.
         ////////////////////////////////////////////////////////////////
 
         /**
-         * \brief Read binary message data from the istream and write a formatted string to the ostream.
-         * \param in Binary istream.
-         * \param out String ostream.
+         * \brief Read binary message data and write a formatted string to the output buffer.
+         * \param in Pointer to binary message data.
+         * \param out Output buffer.
+         * \return Pointer past the message data.
+         */
+        [[nodiscard]] const std::byte* format(const std::byte* in, OutputBuffer& out) const;
+
+        /**
+         * \brief Skip binary message data.
+         * \param in Pointer to binary message data.
+         * \return Pointer past the message data.
          */
-        void format(std::istream& in, std::ostream& out) const;
+        [[nodiscard]] const std::byte* skip(const std::byte* in) const;
 
     private:
         /**
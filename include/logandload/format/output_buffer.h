@@ -0,0 +1,134 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace lal
+{
+    /**
+     * \brief Growable character buffer that collects formatted output, so that it can be written with a single call.
+     * Built-in formatting appends to the buffer directly. Custom formatters write to the stream(), which appends to the
+     * same buffer. The buffer keeps its capacity when it is cleared.
+     */
+    class OutputBuffer final : public std::streambuf
+    {
+    public:
+        ////////////////////////////////////////////////////////////////
+        // Constructors.
+        ////////////////////////////////////////////////////////////////
+
+        OutputBuffer();
+
+        OutputBuffer(const OutputBuffer&) = delete;
+
+        OutputBuffer(OutputBuffer&&) = delete;
+
+        ~OutputBuffer() noexcept override;
+
+        OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+        OutputBuffer& operator=(OutputBuffer&&) = delete;
+
+        ////////////////////////////////////////////////////////////////
+        // Getters.
+        ////////////////////////////////////////////////////////////////
+
+        /**
+         * \brief Get an output stream that appends to this buffer.
+         * \return Output stream.
+         */
+        [[nodiscard]] std::ostream& stream() noexcept;
+
+        /**
+         * \brief Get the number of characters in the buffer.
+         * \return Number of characters.
+         */
+        [[nodiscard]] size_t size() const noexcept;
+
+        ////////////////////////////////////////////////////////////////
+        // Append.
+        ////////////////////////////////////////////////////////////////
+
+        /**
+         * \brief Append a character.
+         * \param c Character.
+         */
+        void append(char c);
+
+        /**
+         * \brief Append a string.
+         * \param str String.
+         */
+        void append(std::string_view str);
+
+        /**
+         * \brief Append a number. The result is the same as writing it to a default constructed std::ostream, i.e.
+         * floating point values are written in general format with a precision of 6.
+         * \tparam T Integral or floating point type.
+         * \param value Value.
+         */
+        template<typename T>
+            requires std::is_arithmetic_v<T>
+        void appendNumber(const T value)
+        {
+            // Enough for any integer, and for any floating point value with a precision of 6.
+            static constexpr size_t maxSize = 64;
+            char*                   first   = reserve(maxSize);
+            std::to_chars_result    result;
+            if constexpr (std::is_floating_point_v<T>)
+                result = std::to_chars(first, first + maxSize, value, std::chars_format::general, 6);
+            else
+                result = std::to_chars(first, first + maxSize, value);
+            pbump(static_cast<int>(result.ptr - first));
+        }
+
+        /**
+         * \brief Append an unsigned integer, padded on the left to a minimum width.
+         * \param value Value.
+         * \param width Minimum width.
+         * \param fill Padding character.
+         */
+        void appendPadded(uint64_t value, size_t width, char fill);
+
+        ////////////////////////////////////////////////////////////////
+        // Output.
+        ////////////////////////////////////////////////////////////////
+
+        /**
+         * \brief Write the contents of the buffer to an output stream and clear it.
+         * \param target Output stream.
+         */
+        void writeTo(std::ostream& target);
+
+    protected:
+        int_type overflow(int_type ch) override;
+
+        std::streamsize xsputn(const char* s, std::streamsize count) override;
+
+    private:
+        /**
+         * \brief Make room for at least the given number of characters after the current position.
+         * \param count Number of characters.
+         * \return Current position.
+         */
+        char* reserve(size_t count);
+
+        ////////////////////////////////////////////////////////////////
+        // Member variables.
+        ////////////////////////////////////////////////////////////////
+
+        std::vector<char> buffer;
+
+        std::ostream out;
+    };
+}  // namespace lal
@@ -4,16 +4,23 @@
 // Standard includes.
 ////////////////////////////////////////////////////////////////
 
+#include <cstddef>
+#include <cstring>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 ////////////////////////////////////////////////////////////////
 // Current target includes.
 ////////////////////////////////////////////////////////////////
 
 #include "logandload/log/format_type.h"
+#include "logandload/format/output_buffer.h"
 
 namespace lal
 {
@@ -40,17 +47,25 @@ namespace lal
         ////////////////////////////////////////////////////////////////
 
         /**
-         * \brief Size of parameter in bytes.
+         * \brief Size of parameter in bytes. 0 for variable-length parameters.
          * \return Size.
          */
         [[nodiscard]] virtual size_t size() const noexcept = 0;
 
         /**
          * \brief Read parameter from input and write formatted value to output.
-         * \param in Input stream.
-         * \param out Output stream.
+         * \param in Pointer to binary parameter data.
+         * \param out Output buffer.
+         * \return Pointer past the parameter.
          */
-        virtual void format(std::istream& in, std::ostream& out) const = 0;
+        [[nodiscard]] virtual const std::byte* format(const std::byte* in, OutputBuffer& out) const = 0;
+
+        /**
+         * \brief Skip parameter in input.
+         * \param in Pointer to binary parameter data.
+         * \return Pointer past the parameter.
+         */
+        [[nodiscard]] virtual const std::byte* skip(const std::byte* in) const = 0;
     };
 
     using IParameterFormatterPtr = std::unique_ptr<IParameterFormatter>;
@@ -62,13 +77,31 @@ namespace lal
         using type                        = T;
         using func_t                      = std::function<void(std::ostream&, const type&)>;
         static constexpr ParameterKey key = hashParameter<T>();
-        func_t                        func;
+
+        /**
+         * \brief Whether values can be appended to the output buffer without a formatting function. These are the types
+         * supported by std::to_chars, std::byte and std::string_view.
+         */
+        static constexpr bool builtin =
+          std::is_floating_point_v<type> || std::is_same_v<type, std::byte> || std::is_same_v<type, std::string_view> ||
+          (std::is_integral_v<type> && !std::is_same_v<type, bool> && !std::is_same_v<type, wchar_t> &&
+           !std::is_same_v<type, char8_t> && !std::is_same_v<type, char16_t> && !std::is_same_v<type, char32_t>);
+
+        /**
+         * \brief Formatting function. If empty, built-in formatting is used.
+         */
+        func_t func;
 
         ////////////////////////////////////////////////////////////////
         // Constructors.
         ////////////////////////////////////////////////////////////////
 
-        ParameterFormatter() = delete;
+        /**
+         * \brief Construct with built-in formatting, which writes the same as operator<<.
+         */
+        ParameterFormatter()
+            requires builtin
+        = default;
 
         explicit ParameterFormatter(func_t f) : func(std::move(f)) {}
 
@@ -86,13 +119,75 @@ namespace lal
         // Format.
         ////////////////////////////////////////////////////////////////
 
-        [[nodiscard]] size_t size() const noexcept override { return sizeof(type); }
+        [[nodiscard]] size_t size() const noexcept override
+        {
+            if constexpr (is_variable_parameter_v<type>)
+                return 0;
+            else
+                return sizeof(type);
+        }
+
+        [[nodiscard]] const std::byte* format(const std::byte* in, OutputBuffer& out) const override
+        {
+            if constexpr (is_variable_parameter_v<type>)
+            {
+                // Read size prefix. Elements are copied to a temporary, which the value refers to, because the data is
+                // not necessarily aligned.
+                using element_t = std::remove_const_t<std::remove_pointer_t<decltype(std::declval<type>().data())>>;
+                uint32_t size   = 0;
+                std::memcpy(&size, in, sizeof size);
+                in += sizeof size;
+                if constexpr (alignof(element_t) == 1)
+                    write(out, type(reinterpret_cast<const element_t*>(in), size / sizeof(element_t)));
+                else
+                {
+                    std::vector<element_t> elements(size / sizeof(element_t));
+                    std::memcpy(elements.data(), in, size);
+                    write(out, type(elements.data(), elements.size()));
+                }
+                return in + size;
+            }
+            else
+            {
+                type value;
+                std::memcpy(&value, in, sizeof(type));
+                write(out, value);
+                return in + sizeof(type);
+            }
+        }
+
+        [[nodiscard]] const std::byte* skip(const std::byte* in) const override
+        {
+            if constexpr (is_variable_parameter_v<type>)
+            {
+                uint32_t size = 0;
+                std::memcpy(&size, in, sizeof size);
+                return in + sizeof size + size;
+            }
+            else
+                return in + sizeof(type);
+        }
 
-        void format(std::istream& in, std::ostream& out) const override
+    private:
+        void write(OutputBuffer& out, const type& value) const
         {
-            type value;
-            in.read(reinterpret_cast<char*>(&value), size());
-            func(out, value);
+            if constexpr (builtin)
+            {
+                if (!func)
+                {
+                    if constexpr (std::is_same_v<type, std::string_view>)
+                        out.append(value);
+                    else if constexpr (std::is_same_v<type, std::byte>)
+                        out.appendNumber(std::to_integer<uint32_t>(value));
+                    else if constexpr (sizeof(type) == 1 && std::is_integral_v<type>)
+                        out.append(static_cast<char>(value));  // Like operator<<, which writes them as characters.
+                    else
+                        out.appendNumber(value);
+                    return;
+                }
+            }
+
+            func(out.stream(), value);
         }
     };
 }  // namespace lal
@@ -0,0 +1,30 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+
+namespace lal
+{
+    enum class Buffering : uint8_t
+    {
+        /**
+         * \brief Each stream has a front and back buffer. Writing blocks while the back buffer is still being processed.
+         */
+        Double = 0,
+
+        /**
+         * \brief Each stream has a single-producer/single-consumer ring buffer. Writing only blocks when the ring is full.
+         */
+        Ring = 1,
+
+        /**
+         * \brief Flight recorder. Each stream has a circular buffer of chunks and overwrites its oldest chunk when it is
+         * full, so writing never blocks. Nothing is written to the log file until Log::dump is called or the process
+         * receives a fatal signal.
+         */
+        Circular = 2
+    };
+}  // namespace lal
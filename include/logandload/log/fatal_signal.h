@@ -0,0 +1,60 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <filesystem>
+
+namespace lal
+{
+    /**
+     * \brief Function called when the process receives a fatal signal. Must only do async-signal-safe work.
+     */
+    using FatalSignalCallback = void (*)(void* context) noexcept;
+
+    /**
+     * \brief Maximum number of callbacks that can be registered at the same time.
+     */
+    constexpr size_t maxFatalSignalCallbacks = 16;
+
+    /**
+     * \brief Register a function that is called when the process receives SIGSEGV, SIGBUS, SIGFPE, SIGILL or SIGABRT.
+     * Handlers for these signals are installed on first use. After all callbacks were called, the previous handler
+     * is restored and the signal is raised again. Not supported on Windows, where callbacks are never called.
+     * \param callback Callback.
+     * \param context Context passed to the callback.
+     * \return Handle for removing the callback.
+     */
+    [[nodiscard]] size_t addFatalSignalCallback(FatalSignalCallback callback, void* context);
+
+    /**
+     * \brief Remove a callback. Must not be called while a fatal signal is being handled.
+     * \param handle Handle returned by addFatalSignalCallback.
+     */
+    void removeFatalSignalCallback(size_t handle) noexcept;
+
+    /**
+     * \brief Open a file for writing from a signal handler.
+     * \param path Path to file.
+     * \param truncate If true, existing contents are discarded. Otherwise, writing starts at the beginning of the file.
+     * \return File descriptor, or -1 on failure.
+     */
+    [[nodiscard]] int openFileSignalSafe(const std::filesystem::path::value_type* path, bool truncate) noexcept;
+
+    /**
+     * \brief Write data to a file from a signal handler. Retries partial writes.
+     * \param fd File descriptor.
+     * \param data Data.
+     * \param size Size in bytes.
+     * \return True on success.
+     */
+    bool writeFileSignalSafe(int fd, const void* data, size_t size) noexcept;
+
+    /**
+     * \brief Close a file from a signal handler.
+     * \param fd File descriptor.
+     */
+    void closeFileSignalSafe(int fd) noexcept;
+}  // namespace lal
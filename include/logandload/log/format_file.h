@@ -0,0 +1,76 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+
+////////////////////////////////////////////////////////////////
+// Current target includes.
+////////////////////////////////////////////////////////////////
+
+#include "logandload/log/ordering.h"
+#include "logandload/log/timestamps.h"
+
+namespace lal
+{
+    /**
+     * \brief Header at the start of a format file. It is followed by the number of streams (size_t), the message
+     * order setting (uint8_t), the timestamp source (uint8_t) and, if timestamps are enabled, the calibration (double
+     * ticks per nanosecond, uint64_t anchor ticks, int64_t anchor nanoseconds). After that come the formats. Each
+     * parameter of a format is stored as its ParameterKey followed by a uint8_t that is 1 for variable-length
+     * parameters. Format files of version 1 have no header and only store the number of streams and the message order
+     * setting, which is either disabled or enabled. Their logs have no timestamps and their parameters are stored as
+     * ParameterKey only.
+     */
+    struct FormatFileHeader
+    {
+        static constexpr uint64_t currentMagic   = 0x0000544d464c414c;  // "LALFMT\0\0"
+        static constexpr uint32_t currentVersion = 2;
+
+        uint64_t magic   = currentMagic;
+        uint32_t version = currentVersion;
+
+        /**
+         * \brief Reserved, always 0.
+         */
+        uint32_t flags = 0;
+    };
+
+    static_assert(sizeof(FormatFileHeader) == 16);
+
+    /**
+     * \brief Settings of a log as stored at the start of its format file.
+     */
+    struct FormatFileSettings
+    {
+        uint32_t version = FormatFileHeader::currentVersion;
+
+        size_t streamCount = 0;
+
+        Ordering order = Ordering::Disabled;
+
+        Calibration calibration;
+    };
+
+    /**
+     * \brief Get the size of the file header of a format file, i.e. the offset of the number of streams.
+     * \param version Version.
+     * \return Size in bytes.
+     */
+    [[nodiscard]] constexpr size_t formatFileHeaderSize(const uint32_t version) noexcept
+    {
+        return version == 1 ? 0 : sizeof(FormatFileHeader);
+    }
+
+    /**
+     * \brief Read the header and settings of a format file. Afterwards, the stream is positioned at the first format.
+     * \param in Stream positioned at the start of the format file.
+     * \return Settings.
+     * \throws LalError If the version is not supported.
+     */
+    [[nodiscard]] FormatFileSettings readFormatFileSettings(std::istream& in);
+}  // namespace lal
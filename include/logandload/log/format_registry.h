@@ -0,0 +1,165 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <format>
+#include <source_location>
+#include <span>
+#include <string>
+#include <string_view>
+
+////////////////////////////////////////////////////////////////
+// Current target includes.
+////////////////////////////////////////////////////////////////
+
+#include "logandload/log/format_type.h"
+
+namespace lal
+{
+    /**
+     * \brief Format information of a single message type. Nodes are static objects that are linked into a
+     * FormatRegistry during static initialization and are never removed.
+     */
+    struct FormatRegistration
+    {
+        MessageKey                    key;
+        std::string_view              message;
+        uint32_t                      category = 0;
+        std::span<const ParameterKey> parameters;
+
+        /**
+         * \brief For each parameter, whether it has a variable length.
+         */
+        std::span<const bool>     variable;
+        const FormatRegistration* next = nullptr;
+    };
+
+    /**
+     * \brief Lock-free intrusive list of all formats that can be written by a log type.
+     */
+    class FormatRegistry
+    {
+    public:
+        constexpr FormatRegistry() noexcept = default;
+
+        FormatRegistry(const FormatRegistry&) = delete;
+
+        FormatRegistry(FormatRegistry&&) = delete;
+
+        ~FormatRegistry() noexcept = default;
+
+        FormatRegistry& operator=(const FormatRegistry&) = delete;
+
+        FormatRegistry& operator=(FormatRegistry&&) = delete;
+
+        /**
+         * \brief Push a format onto the front of the list.
+         * \param format Format. Must outlive the registry.
+         */
+        void add(FormatRegistration& format) noexcept
+        {
+            format.next = head.load(std::memory_order_relaxed);
+            while (!head.compare_exchange_weak(
+              format.next, &format, std::memory_order_release, std::memory_order_relaxed))
+                ;
+        }
+
+        /**
+         * \brief Get the first format in the list. Follow FormatRegistration::next for the remaining formats.
+         * \return First format or nullptr.
+         */
+        [[nodiscard]] const FormatRegistration* front() const noexcept
+        {
+            return head.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::atomic<const FormatRegistration*> head = nullptr;
+    };
+
+    /**
+     * \brief Registry of formats, one per tag type. Constant initialized, so registrars can safely add to it during
+     * dynamic initialization.
+     * \tparam Tag Tag type, usually a Log.
+     */
+    template<typename Tag>
+    constinit inline FormatRegistry formatRegistry;
+
+    /**
+     * \brief Adds the format of a message type to formatRegistry<Tag> when constructed.
+     * \tparam Tag Tag type.
+     * \tparam F Format type.
+     * \tparam Ts Dynamic parameter types.
+     */
+    template<typename Tag, typename F, typename... Ts>
+    class FormatRegistrar
+    {
+    public:
+        FormatRegistrar() noexcept { formatRegistry<Tag>.add(format); }
+
+        FormatRegistrar(const FormatRegistrar&) = delete;
+
+        FormatRegistrar(FormatRegistrar&&) = delete;
+
+        ~FormatRegistrar() noexcept = default;
+
+        FormatRegistrar& operator=(const FormatRegistrar&) = delete;
+
+        FormatRegistrar& operator=(FormatRegistrar&&) = delete;
+
+    private:
+        static constexpr std::array<ParameterKey, sizeof...(Ts)> parameters = {hashParameter<parameter_t<Ts>>()...};
+
+        static constexpr std::array<bool, sizeof...(Ts)> variable = {is_variable_parameter_v<parameter_t<Ts>>...};
+
+        FormatRegistration format{hashMessage<F, Ts...>(), F::message, F::category, parameters, variable};
+    };
+
+    /**
+     * \brief Static registrar of a message type. Referencing it anywhere (e.g. by taking its address) instantiates it,
+     * which registers the format before main is entered, at no cost to the referencing code.
+     * \tparam Tag Tag type.
+     * \tparam F Format type.
+     * \tparam Ts Dynamic parameter types.
+     */
+    template<typename Tag, typename F, typename... Ts>
+    inline FormatRegistrar<Tag, F, Ts...> formatRegistrar;
+
+    /**
+     * \brief Adds a source location to formatRegistry<Tag> when constructed. It is stored as a format without
+     * parameters, whose message is the location. Unlike formats, source locations are only known at runtime, so the
+     * registrar is a static that is constructed on first use.
+     * \tparam Tag Tag type.
+     */
+    template<typename Tag>
+    class SourceRegistrar
+    {
+    public:
+        SourceRegistrar(const MessageKey key, const std::source_location& loc) :
+            location(std::format("{}({},{})", loc.file_name(), loc.line(), loc.column())),
+            format{key, location, 0, {}, {}}
+        {
+            formatRegistry<Tag>.add(format);
+        }
+
+        SourceRegistrar(const SourceRegistrar&) = delete;
+
+        SourceRegistrar(SourceRegistrar&&) = delete;
+
+        ~SourceRegistrar() noexcept = default;
+
+        SourceRegistrar& operator=(const SourceRegistrar&) = delete;
+
+        SourceRegistrar& operator=(SourceRegistrar&&) = delete;
+
+    private:
+        std::string location;
+
+        FormatRegistration format;
+    };
+}  // namespace lal
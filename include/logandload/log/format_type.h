@@ -8,8 +8,11 @@
 #include <functional>
 #include <iostream>
 #include <limits>
+#include <span>
 #include <string>
+#include <string_view>
 #include <source_location>
+#include <type_traits>
 #include <vector>
 
 ////////////////////////////////////////////////////////////////
@@ -41,8 +44,68 @@ namespace lal
         static constexpr MessageKey AnonymousRegionStart = {0};
         static constexpr MessageKey NamedRegionStart     = {1};
         static constexpr MessageKey RegionEnd            = {2};
+
+        /**
+         * \brief Followed by the number of dropped messages and their size in bytes, both as uint64_t.
+         */
+        static constexpr MessageKey Dropped = {3};
+
+        /**
+         * \brief Followed by the number of messages a sampled or rate limited format suppressed as uint64_t, and the
+         * key of that format.
+         */
+        static constexpr MessageKey Suppressed = {4};
     };
 
+    /**
+     * \brief Type as which a parameter is written. Strings are written as std::string_view and spans of any extent as
+     * std::span<const T>.
+     * \tparam T Parameter type.
+     */
+    template<typename T>
+    struct parameter_type
+    {
+        using type = T;
+    };
+
+    template<>
+    struct parameter_type<std::string>
+    {
+        using type = std::string_view;
+    };
+
+    template<typename T, size_t N>
+    struct parameter_type<std::span<T, N>>
+    {
+        using type = std::span<const std::remove_const_t<T>>;
+    };
+
+    template<typename T>
+    using parameter_t = typename parameter_type<T>::type;
+
+    /**
+     * \brief Variable-length parameters are std::string_view and std::span<const T> of trivially copyable T. Their data
+     * is preceded by its size in bytes as uint32_t.
+     * \tparam T Parameter type, as returned by parameter_t.
+     */
+    template<typename T>
+    struct is_variable_parameter : std::false_type
+    {
+    };
+
+    template<>
+    struct is_variable_parameter<std::string_view> : std::true_type
+    {
+    };
+
+    template<typename T>
+    struct is_variable_parameter<std::span<const T>> : std::bool_constant<std::is_trivially_copyable_v<T>>
+    {
+    };
+
+    template<typename T>
+    constexpr bool is_variable_parameter_v = is_variable_parameter<T>::value;
+
     /**
      * \brief Hash an uint32_t. (Thomas Wang, Jan 1997)
      * \param s Value.
@@ -210,7 +273,7 @@ namespace lal
     requires is_format_type<F, Ts...>
     [[nodiscard]] consteval MessageKey hashMessage() noexcept
     {
-        return MessageKey{((hash(F::message) ^ hash(F::category)) ^ ... ^ hashParameter<Ts>().key)};
+        return MessageKey{((hash(F::message) ^ hash(F::category)) ^ ... ^ hashParameter<parameter_t<Ts>>().key)};
     }
 
     /**
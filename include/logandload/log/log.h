@@ -4,9 +4,16 @@
 // Standard includes.
 ////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <deque>
 #include <filesystem>
 #include <format>
 #include <fstream>
@@ -14,11 +21,15 @@
 #include <future>
 #include <memory>
 #include <mutex>
+#include <numeric>
+#include <optional>
 #include <semaphore>
+#include <span>
 #include <stop_token>
+#include <string_view>
 #include <thread>
 #include <tuple>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
 ////////////////////////////////////////////////////////////////
@@ -31,30 +42,61 @@
 // Current target includes.
 ////////////////////////////////////////////////////////////////
 
+#include "logandload/log/fatal_signal.h"
+#include "logandload/log/format_file.h"
+#include "logandload/log/log_file.h"
+#include "logandload/log/log_settings.h"
+#include "logandload/log/mapped_file.h"
+#include "logandload/log/recovery.h"
 #include "logandload/log/stream.h"
+#include "logandload/log/writer_backend.h"
 #include "logandload/utils/lal_error.h"
 
 namespace lal
 {
-    template<is_category_filter C, Ordering Order>
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
     class Log
     {
+        static_assert(Order != Ordering::Timestamp || Time != Timestamps::Disabled,
+                      "Ordering::Timestamp requires timestamps to be enabled.");
+
     public:
         ////////////////////////////////////////////////////////////////
         // Types.
         ////////////////////////////////////////////////////////////////
 
-        struct FormatType
-        {
-            std::string               message;
-            uint32_t                  category = 0;
-            std::vector<ParameterKey> parameters;
-        };
-
-        using stream_t   = Stream<C, Order>;
+        using stream_t   = Stream<C, Order, Buf, Time>;
         using category_t = C;
         friend stream_t;
 
+        struct GlobalBuffer
+        {
+            /**
+             * \brief Buffer data. Aligned to 64 bytes.
+             */
+            uint8_t* data = nullptr;
+
+            /**
+             * \brief Number of bytes that contain valid data. Always <= size.
+             */
+            size_t used = 0;
+
+            /**
+             * \brief Segments of a gathered write. Only used in zero-copy mode.
+             */
+            std::vector<WriteSegment> segments;
+
+            /**
+             * \brief Streams to release once this buffer is written, with the ring position up to which data was taken.
+             */
+            std::vector<std::pair<stream_t*, size_t>> streams;
+
+            /**
+             * \brief Set by the writer thread once the write of this buffer completed.
+             */
+            bool written = false;
+        };
+
         ////////////////////////////////////////////////////////////////
         // Constructors.
         ////////////////////////////////////////////////////////////////
@@ -62,9 +104,12 @@ namespace lal
         /**
          * \brief Construct a new Log object. 
          * \param path Path to log file. Format file path is set to log_path + ".fmt".
-         * \param globalBufferSize Global buffer size (in bytes).
+         * \param globalBufferSize Size of each global buffer (in bytes). In zero-copy mode, global buffers only hold
+         * block headers. In memory-mapped mode, size of the mapped chunks. Unused with Buffering::Circular.
+         * \param settings Runtime settings.
+         * \throws LalError If the settings are invalid or the log file could not be opened.
          */
-        Log(std::filesystem::path path, size_t globalBufferSize);
+        Log(std::filesystem::path path, size_t globalBufferSize, LogSettings settings = {});
 
         Log() = delete;
 
@@ -84,10 +129,42 @@ namespace lal
 
         /**
          * \brief Create a new stream to write to this log.
-         * \param size Size of stream buffer in bytes.
+         * \param size Size of stream buffer in bytes. With Buffering::Ring, this is the size of the ring. With
+         * Buffering::Circular, this is the total size of all chunks.
+         * \param overflow What the stream does when the log cannot keep up. Dropped messages are recorded in the log.
+         * Ignored with Buffering::Circular, which overwrites its oldest data instead. Overflow::DropBuffer cannot be
+         * combined with LogSettings::maxFlushLatency, because data that was taken early can no longer be dropped.
          * \return Non-owning pointer to new stream.
          */
-        [[nodiscard]] stream_t& createStream(size_t size);
+        [[nodiscard]] stream_t& createStream(size_t size, Overflow overflow = Overflow::Block);
+
+        /**
+         * \brief Get the number of times the processor thread had to wait because no global buffer was free.
+         * \return Count.
+         */
+        [[nodiscard]] uint64_t getPoolExhaustedCount() const noexcept;
+
+        /**
+         * \brief Set the minimum category of messages that are logged. Applied on top of the compile-time category
+         * filter, so messages that are filtered out at compile time cannot be enabled. Lock-free, so it can be called
+         * from any thread and from signal handlers.
+         * \param category Minimum category. 0 logs all messages.
+         */
+        void setMinimumCategory(uint32_t category) noexcept;
+
+        /**
+         * \brief Get the minimum category of messages that are logged.
+         * \return Minimum category.
+         */
+        [[nodiscard]] uint32_t getMinimumCategory() const noexcept;
+
+        /**
+         * \brief Write the contents of all streams to the log file, replacing earlier dumps, and update the format
+         * file. Streams can keep writing while they are dumped. Of each stream, all chunks except the one that is being
+         * overwritten at the time are dumped. The dump can be read like any other log.
+         * \throws LalError If the log file could not be written.
+         */
+        void dump() requires(Buf == Buffering::Circular);
 
     private:
         /**
@@ -96,6 +173,12 @@ namespace lal
          */
         void flush(stream_t& stream);
 
+        /**
+         * \brief Take all streams from the queue.
+         * \return First stream in flush order. Following streams can be reached through stream_t::next.
+         */
+        stream_t* takeQueue();
+
         /**
          * \brief Function that is run in the processor thread to copy queued stream buffers to the global front buffer.
          * \param token Stop token.
@@ -103,22 +186,136 @@ namespace lal
         void process(std::stop_token token);
 
         /**
-         * \brief Function that is run in the writer thread to write the back buffer to log file.
+         * \brief Copy or gather the data of a list of flushed streams.
+         * \param stream First stream in list.
+         */
+        void processQueue(stream_t* stream);
+
+        /**
+         * \brief Copy or gather the committed data of a ring that was not taken yet.
+         * \param stream Stream.
+         */
+        void processCommitted(stream_t& stream);
+
+        /**
+         * \brief Copy or gather the committed data of all streams and hand the global front buffer to the writer, so
+         * that no record stays in memory for longer than the maximum flush latency.
+         */
+        void processIdle();
+
+        /**
+         * \brief Function that is run in the timer thread to periodically wake the processor thread.
+         * \param token Stop token.
+         */
+        void tick(std::stop_token token);
+
+        /**
+         * \brief Copy or gather the data in a stream that was not flushed yet. Only used on destruction.
+         * \param stream Stream.
+         */
+        void processRemaining(stream_t& stream);
+
+        /**
+         * \brief Hand the global front buffer to the writer thread and take a new one from the free list, waiting if
+         * the pool is exhausted.
+         */
+        void swap();
+
+        /**
+         * \brief Write the log file header to the global front buffer.
+         */
+        void writeFileHeader();
+
+        /**
+         * \brief Copy a block of stream data to the global front buffer, preceded by the stream index and block size.
+         * \param index Stream index.
+         * \param first First part of the block.
+         * \param second Second part of the block. Used when the data wrapped around the end of a ring.
+         */
+        void copyBlock(size_t index, std::span<const uint8_t> first, std::span<const uint8_t> second = {});
+
+        /**
+         * \brief Add a block of stream data to the front batch, preceded by the stream index and block size. Only
+         * the header is copied to the global front buffer.
+         * \param stream Stream.
+         * \param position Ring position up to which data was taken.
+         * \param first First part of the block.
+         * \param second Second part of the block. Used when the data wrapped around the end of a ring.
+         */
+        void gatherBlock(stream_t&                stream,
+                         size_t                   position,
+                         std::span<const uint8_t> first,
+                         std::span<const uint8_t> second = {});
+
+        /**
+         * \brief Signal to a stream that the log is done with its data.
+         * \param stream Stream.
+         * \param position Ring position up to which data was taken.
+         */
+        void release(stream_t& stream, size_t position);
+
+        /**
+         * \brief Function that is run in the writer thread to write ready buffers to log file.
          * \param token Stop token.
          */
         void write(std::stop_token token);
 
-        template<typename F, typename... Ts>
-        void registerFormat(MessageKey key);
+        /**
+         * \brief Handle a completed write. Buffers are returned to the free list in the order in which they were
+         * submitted, so that streams are released in order.
+         * \param index Index of the buffer that was written.
+         */
+        void completeWrite(size_t index);
 
-        template<MessageKey K>
-        void registerSourceLocation(const std::source_location& loc);
+        /**
+         * \brief Register a source location with formatRegistry<Log>. Called by a stream the first time it writes the
+         * source location, after which the stream only checks the guard of a static. Message formats do not need to be
+         * registered, they are added to formatRegistry<Log> during static initialization.
+         * \tparam K Hash of source location.
+         * \param loc Source location.
+         * \return True.
+         */
+        template<uint32_t K>
+        bool registerSourceLocation(const std::source_location& loc);
 
         /**
-         * \brief Write all format information to disk.
+         * \brief Update the header of the format file and append all formats that were not written yet. Called by the
+         * writer thread before each write (the processor thread in memory-mapped mode), so that the format file always
+         * describes the log file. Can be called from any thread.
          */
         void writeFormats();
 
+        /**
+         * \brief Check whether there are formats or source locations that were not written to the format file yet.
+         * \return True if writeFormats has work to do.
+         */
+        [[nodiscard]] bool hasUnwrittenFormats() const noexcept;
+
+        /**
+         * \brief Write remaining formats and the final calibration and close the format file.
+         */
+        void closeFormats();
+
+        /**
+         * \brief Size of the format file header in bytes.
+         */
+        static constexpr size_t formatHeaderSize =
+          sizeof(FormatFileHeader) + sizeof(size_t) + 2 +
+          (Time != Timestamps::Disabled ? sizeof(double) + sizeof(uint64_t) + sizeof(int64_t) : 0);
+
+        /**
+         * \brief Serialize the header of the format file. Async-signal-safe.
+         * \return Header.
+         */
+        [[nodiscard]] std::array<uint8_t, formatHeaderSize> formatHeader() const noexcept;
+
+        /**
+         * \brief Dump all streams and rewrite the header of the format file. Registered as fatal signal callback.
+         * Formats are already written when they are registered.
+         * \param context Log.
+         */
+        static void dumpOnSignal(void* context) noexcept;
+
         ////////////////////////////////////////////////////////////////
         // Member variables.
         ////////////////////////////////////////////////////////////////
@@ -131,24 +328,45 @@ namespace lal
             std::filesystem::path path;
 
             /**
-             * \brief Log file handle.
+             * \brief Format file path.
              */
-            std::ofstream file;
+            std::filesystem::path fmtPath;
 
             /**
-             * \brief List of registered formats.
+             * \brief Runtime settings.
              */
-            std::unordered_map<MessageKey, FormatType> formats;
+            LogSettings settings;
 
             /**
-             * \brief Mutex for formats.
+             * \brief Format file.
              */
-            std::mutex mutex;
+            std::ofstream fmtFile;
+
+            /**
+             * \brief Mutex for the format file, which is usually only written by the writer or processor thread.
+             */
+            std::mutex fmtMutex;
+
+            /**
+             * \brief Most recently registered format that was written to the format file.
+             */
+            std::atomic<const FormatRegistration*> writtenFormat = nullptr;
 
             /**
              * \brief Atomic int used if ordering is enabled.
              */
             std::atomic_uint64_t messageIndex = 0;
+
+            /**
+             * \brief Minimum category of messages that are logged. Read by every message, but rarely written, so it does
+             * not share a cache line with messageIndex.
+             */
+            alignas(64) std::atomic_uint32_t minimumCategory = 0;
+
+            /**
+             * \brief Handle of dumpOnSignal if it was registered.
+             */
+            std::optional<size_t> fatalSignalCallback;
         } log;
 
         struct
@@ -156,12 +374,35 @@ namespace lal
             std::vector<std::unique_ptr<stream_t>> streams;
 
             /**
-             * \brief List of all streams that have a back buffer that need to be flushed.
+             * \brief Head of the lock-free intrusive list of all streams that have a back buffer that needs to be flushed.
+             * Streams are pushed onto the front, so the list is in reverse flush order.
+             */
+            std::atomic<stream_t*> queue = nullptr;
+
+            /**
+             * \brief Number of streams. Can be read without locking the mutex.
+             */
+            std::atomic_size_t count = 0;
+
+            /**
+             * \brief Pointers to the first count streams, for readers that do not lock the mutex (dumpOnSignal and
+             * processIdle). When full, the table is replaced by a larger copy. Replaced tables are kept alive in tables
+             * until the log is destroyed, so a reader can keep using any table it loaded.
+             */
+            std::atomic<stream_t* const*> table = nullptr;
+
+            /**
+             * \brief All tables ever published. The last one is the current table.
+             */
+            std::vector<std::unique_ptr<stream_t*[]>> tables;
+
+            /**
+             * \brief Capacity of the current table.
              */
-            std::vector<stream_t*> queue;
+            size_t capacity = 0;
 
             /**
-             * \brief Mutex for protecting streams and queue.
+             * \brief Mutex for protecting streams.
              */
             std::mutex mutex;
         } streams;
@@ -169,312 +410,989 @@ namespace lal
         struct
         {
             /**
-             * \brief Size of the front and back buffer in bytes.
+             * \brief Size of each global buffer in bytes.
              */
             size_t size = 0;
 
             /**
-             * \brief Front buffer. Aligned to 64 bytes.
+             * \brief All global buffers.
              */
-            uint8_t* front = nullptr;
+            std::vector<GlobalBuffer> pool;
 
             /**
-             * \brief Current offset in the front buffer.
+             * \brief Index of the front buffer, which is being filled by the processor thread.
              */
-            size_t offset = 0;
+            size_t frontIndex = 0;
 
             /**
-             * \brief Back buffer. Aligned to 64 bytes.
+             * \brief Data of the front buffer. In memory-mapped mode, the currently mapped chunk.
              */
-            uint8_t* back = nullptr;
+            uint8_t* front = nullptr;
 
             /**
-             * \brief Number of bytes in the back buffer that contain valid data. Always <= size.
+             * \brief Current offset in the front buffer.
              */
-            size_t used = 0;
+            size_t offset = 0;
+
+            /**
+             * \brief Number of times the processor thread found the free list empty.
+             */
+            std::atomic_uint64_t exhausted = 0;
         } buffer;
 
         struct
         {
-            std::jthread            thread;
-            std::condition_variable cv;
-            std::atomic_bool        notified;
-            std::mutex              mutex;
+            std::jthread thread;
+
+            /**
+             * \brief Set when new streams were queued. Processor thread waits on this flag.
+             */
+            std::atomic_bool notified = false;
+
+            /**
+             * \brief Thread that wakes the processor at half the maximum flush latency.
+             */
+            std::jthread timer;
+
+            /**
+             * \brief Set by the timer thread when idle streams must be processed.
+             */
+            std::atomic_bool expired = false;
         } processor;
 
         struct
         {
-            std::binary_semaphore signalSemaphore;
-            std::binary_semaphore doneSemaphore;
-            std::jthread          thread;
+            /**
+             * \brief Number of buffers in the ready list.
+             */
+            std::counting_semaphore<> readySemaphore{0};
+
+            /**
+             * \brief Number of buffers in the free list.
+             */
+            std::counting_semaphore<> freeSemaphore{0};
+
+            std::jthread thread;
+
+            /**
+             * \brief Ring of buffer indices handed from the processor to the writer thread.
+             */
+            std::vector<size_t> readyList;
+
+            /**
+             * \brief Ring of buffer indices handed from the writer back to the processor thread.
+             */
+            std::vector<size_t> freeList;
+
+            /**
+             * \brief Total number of pushes onto and pops from the lists. Each is only accessed by one thread.
+             */
+            size_t readyPush = 0, readyPop = 0, freePush = 0, freePop = 0;
+
+            /**
+             * \brief Indices of submitted buffers, in submission order.
+             */
+            std::deque<size_t> inFlight;
+
+            /**
+             * \brief Backend that writes to the log file.
+             */
+            IWriterBackendPtr backend;
+
+            /**
+             * \brief Log file in memory-mapped mode. Replaces backend, there is no writer thread.
+             */
+            std::unique_ptr<MappedFile> mapped;
+
+            /**
+             * \brief File that holds the stream buffers in recoverable mode.
+             */
+            std::unique_ptr<RecoveryFile> recovery;
+
+            /**
+             * \brief File offset of the next write. In memory-mapped mode, file offset of the front buffer.
+             */
+            uint64_t offset = 0;
         } writer;
+
+        struct
+        {
+            /**
+             * \brief Ticks of the timestamp source at construction.
+             */
+            uint64_t ticks = 0;
+
+            /**
+             * \brief Steady clock at construction, used to measure the tick rate.
+             */
+            std::chrono::steady_clock::time_point steady;
+
+            /**
+             * \brief System clock at construction, in nanoseconds since its epoch.
+             */
+            int64_t system = 0;
+        } clock;
     };
 
     ////////////////////////////////////////////////////////////////
     // Constructors.
     ////////////////////////////////////////////////////////////////
 
-    template<is_category_filter C, Ordering Order>
-    Log<C, Order>::Log(std::filesystem::path path, const size_t globalBufferSize) :
-        writer(std::binary_semaphore(0), std ::binary_semaphore(1))
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    Log<C, Order, Buf, Time>::Log(std::filesystem::path path, const size_t globalBufferSize, const LogSettings settings)
     {
         assert(globalBufferSize > 0);
+
+        if constexpr (Time != Timestamps::Disabled)
+        {
+            clock.steady = std::chrono::steady_clock::now();
+            clock.system = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+            clock.ticks = readTimestamp<Time>();
+        }
         buffer.size = globalBufferSize;
 
+        log.settings = settings;
+
+        if (log.settings.bufferCount < 2)
+            throw LalError(std::format("Buffer count must be at least 2, got {}", log.settings.bufferCount));
+
+        if (log.settings.recoverable && !log.settings.memoryMapped)
+            throw LalError("Recoverable mode requires memory-mapped mode");
+
+        if (log.settings.memoryMapped)
+        {
+            if (log.settings.zeroCopy || log.settings.directIo)
+                throw LalError("Memory-mapped mode cannot be combined with zero-copy mode or direct I/O");
+            if (Buf == Buffering::Circular)
+                throw LalError("Memory-mapped mode cannot be combined with circular buffering");
+            if (buffer.size % MappedFile::granularity() != 0)
+                throw LalError(std::format("Global buffer size must be a multiple of {} bytes for memory-mapped mode",
+                                           MappedFile::granularity()));
+        }
+        else if (log.settings.directIo)
+        {
+            if (log.settings.zeroCopy) throw LalError("Direct I/O cannot be combined with zero-copy mode");
+            if (Buf == Buffering::Circular) throw LalError("Direct I/O cannot be combined with circular buffering");
+            if (buffer.size % directIoAlignment != 0)
+                throw LalError(std::format("Global buffer size must be a multiple of {} bytes for direct I/O",
+                                           directIoAlignment));
+        }
+
+        // Open format file and write all formats known so far.
+        log.path    = std::move(path);
+        log.fmtPath = log.path;
+        log.fmtPath += ".fmt";
+        log.fmtFile = std::ofstream(log.fmtPath, std::ios::binary | std::ios::trunc);
+        if (!log.fmtFile) throw LalError(std::format("Failed to open format file {}", log.fmtPath.string()));
+        writeFormats();
+
+        // A flight recorder has no global buffers and threads. Its streams are only written to the log file when
+        // they are dumped.
+        if constexpr (Buf == Buffering::Circular)
+        {
+            if (log.settings.dumpOnFatalSignal)
+                log.fatalSignalCallback = addFatalSignalCallback(&Log::dumpOnSignal, this);
+            return;
+        }
+
         // Open log file.
-        log.path = std::move(path);
-        log.file = std::ofstream(log.path, std::ios::binary);
+        if (log.settings.memoryMapped)
+        {
+            writer.mapped = std::make_unique<MappedFile>(log.path);
+            if (!writer.mapped->good())
+                throw LalError(std::format("Failed to open log file {}", log.path.string()));
+
+            // Map first chunk, which becomes the front buffer. A single global buffer is only used as a fallback
+            // if a chunk cannot be mapped, e.g. because the disk is full. Its contents are then discarded.
+            buffer.front = writer.mapped->map(0, buffer.size);
+            if (!buffer.front) throw LalError(std::format("Failed to map log file {}", log.path.string()));
+            buffer.pool.resize(1);
+            buffer.pool.front().data = static_cast<uint8_t*>(common::aligned_alloc(64, buffer.size));
+            writeFileHeader();
+
+            // Stream buffers are created in the recovery file.
+            if (log.settings.recoverable)
+            {
+                auto recPath = log.path;
+                recPath += ".rec";
+                writer.recovery = std::make_unique<RecoveryFile>(recPath, Buf);
+                if (!writer.recovery->good())
+                    throw LalError(std::format("Failed to open recovery file {}", recPath.string()));
+            }
+
+            // Start processor and timer thread.
+            processor.thread = std::jthread(std::bind_front(&Log::process, this));
+            if (log.settings.maxFlushLatency.count() > 0)
+                processor.timer = std::jthread(std::bind_front(&Log::tick, this));
+            return;
+        }
+
+        writer.backend = createWriterBackend(log.path, log.settings);
+        if (!writer.backend->good()) throw LalError(std::format("Failed to open log file {}", log.path.string()));
 
-        if (!log.file) throw LalError(std::format("Failed to open log file {}", log.path.string()));
+        // Create global buffers aligned to 64 bytes, or to the block size for direct I/O.
+        const size_t alignment = log.settings.directIo ? directIoAlignment : 64;
+        buffer.pool.resize(log.settings.bufferCount);
+        std::vector<WriteSegment> registered;
+        for (auto& b : buffer.pool)
+        {
+            b.data = static_cast<uint8_t*>(common::aligned_alloc(alignment, buffer.size));
+            registered.push_back({b.data, buffer.size});
+        }
+        writer.backend->registerBuffers(registered);
 
-        // Create global buffers aligned to 64 bytes.
-        buffer.front = static_cast<uint8_t*>(common::aligned_alloc(64, buffer.size));
-        buffer.back  = static_cast<uint8_t*>(common::aligned_alloc(64, buffer.size));
+        // First buffer is the front buffer, all others are free.
+        buffer.front = buffer.pool.front().data;
+        writer.readyList.resize(buffer.pool.size());
+        writer.freeList.resize(buffer.pool.size());
+        for (size_t i = 1; i < buffer.pool.size(); i++) writer.freeList[writer.freePush++] = i;
+        writer.freeSemaphore.release(static_cast<std::ptrdiff_t>(buffer.pool.size()) - 1);
+        writeFileHeader();
 
-        // Start processor thread.
+        // Start processor and timer thread.
         processor.thread = std::jthread(std::bind_front(&Log::process, this));
+        if (log.settings.maxFlushLatency.count() > 0) processor.timer = std::jthread(std::bind_front(&Log::tick, this));
 
         // Start writer thread.
         writer.thread = std::jthread(std::bind_front(&Log::write, this));
     }
 
-    template<is_category_filter C, Ordering Order>
-    Log<C, Order>::~Log() noexcept
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    Log<C, Order, Buf, Time>::~Log() noexcept
     {
-        // Terminate processor thread.
+        // Streams of a flight recorder are discarded, unless they were dumped.
+        if constexpr (Buf == Buffering::Circular)
+        {
+            if (log.fatalSignalCallback) removeFatalSignalCallback(*log.fatalSignalCallback);
+            closeFormats();
+            return;
+        }
+
+        // Terminate timer and processor thread.
+        if (processor.timer.joinable())
+        {
+            processor.timer.request_stop();
+            processor.timer.join();
+        }
         processor.thread.request_stop();
-        processor.cv.notify_one();
+        processor.notified = true;
+        processor.notified.notify_one();
         processor.thread.join();
 
-        // Terminate writer thread.
-        writer.thread.request_stop();
-        writer.signalSemaphore.release();
-        writer.thread.join();
+        // Process remaining queued streams, followed by the data in all streams that was not flushed yet.
+        // (Note: the order in which these buffers are written is very relevant.)
+        processQueue(takeQueue());
 
-        // Write remaining global front buffer. (Note: the order in which these buffers are written is very relevant.)
-        log.file.write(reinterpret_cast<const char*>(buffer.front), buffer.offset);
+        // Let streams record drops and suppressed messages that were not recorded yet. This can queue them again.
+        for (auto& s : streams.streams)
+        {
+            s->recordDropped();
+            s->recordSuppressed();
+        }
+        processQueue(takeQueue());
+        for (auto& s : streams.streams) processRemaining(*s);
 
-        // Write remaining back buffers in queue.
-        for (auto* stream : streams.queue)
+        // Direct I/O can only write whole blocks. Pad the last buffer with zeros, the padding is truncated below.
+        // (Note: all earlier buffers were full, so only the last one can end in a partial block.)
+        size_t padding = 0;
+        if (log.settings.memoryMapped)
         {
-            if (stream->buffer.used > 0)
+            // Unmap last chunk and cut off its unused part.
+            if (buffer.front != buffer.pool.front().data)
             {
-                log.file.write(reinterpret_cast<const char*>(&stream->index), sizeof stream->index);
-                log.file.write(reinterpret_cast<const char*>(&stream->buffer.used), sizeof stream->buffer.used);
-                log.file.write(reinterpret_cast<const char*>(stream->buffer.back), stream->buffer.used);
+                writer.mapped->unmap(buffer.front, buffer.size);
+                writer.offset += buffer.offset;
             }
+            writer.mapped->truncate(writer.offset);
+            writer.mapped.reset();
+        }
+        else if (log.settings.directIo)
+        {
+            padding = (directIoAlignment - buffer.offset % directIoAlignment) % directIoAlignment;
+            std::fill_n(buffer.front + buffer.offset, padding, uint8_t{0});
+            buffer.offset += padding;
         }
 
-        // Write remaining front buffers of streams to file.
-        for (auto& s : streams.streams)
+        if (!log.settings.memoryMapped)
         {
-            if (s->buffer.offset > 0)
+            // Hand last buffer to writer and wait until all buffers except the new front buffer are free again.
+            swap();
+            for (size_t i = 1; i < buffer.pool.size(); i++) writer.freeSemaphore.acquire();
+
+            // Terminate writer thread. It is woken up without a ready buffer.
+            writer.thread.request_stop();
+            writer.readySemaphore.release();
+            writer.thread.join();
+
+            // Close log file.
+            writer.backend.reset();
+
+            // Remove padding.
+            if (padding > 0)
             {
-                log.file.write(reinterpret_cast<const char*>(&s->index), sizeof s->index);
-                log.file.write(reinterpret_cast<const char*>(&s->buffer.offset), sizeof s->buffer.offset);
-                log.file.write(reinterpret_cast<const char*>(s->buffer.front), s->buffer.offset);
+                std::error_code ec;
+                std::filesystem::resize_file(log.path, writer.offset - padding, ec);
             }
         }
 
-        log.file.close();
+        closeFormats();
 
-        // Write formats file.
-        writeFormats();
+        // Everything is in the log file now.
+        if (writer.recovery)
+        {
+            writer.recovery.reset();
+            auto recPath = log.path;
+            recPath += ".rec";
+            std::error_code ec;
+            std::filesystem::remove(recPath, ec);
+        }
 
+        for (auto& b : buffer.pool)
+        {
 #ifdef WIN32
-        _aligned_free(buffer.front);
-        _aligned_free(buffer.back);
+            _aligned_free(b.data);
 #else
-        std::free(buffer.front);
-        std::free(backBuffer);
+            std::free(b.data);
 #endif
+        }
     }
 
     ////////////////////////////////////////////////////////////////
     // Member functions.
     ////////////////////////////////////////////////////////////////
 
-    template<is_category_filter C, Ordering Order>
-    auto Log<C, Order>::createStream(const size_t size) -> stream_t&
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    auto Log<C, Order, Buf, Time>::createStream(const size_t size, const Overflow overflow) -> stream_t&
     {
-        assert(size <= buffer.size);
+        assert(Buf == Buffering::Circular || log.settings.zeroCopy || size <= buffer.size);
+        if (Buf != Buffering::Circular && overflow == Overflow::DropBuffer && log.settings.maxFlushLatency.count() > 0)
+            throw LalError("Overflow::DropBuffer cannot be combined with a maximum flush latency");
 
         std::scoped_lock lock(streams.mutex);
-        auto& s = *streams.streams.emplace_back(std::make_unique<stream_t>(*this, streams.streams.size(), size));
-        streams.queue.reserve(streams.streams.size());
-        return s;
+
+        RecoveryStream* recovery = nullptr;
+        if (writer.recovery)
+        {
+            recovery = writer.recovery->addStream(streams.streams.size(), size, Buf == Buffering::Double ? 2 : 1);
+            if (!recovery) throw LalError("Failed to add stream to recovery file");
+        }
+
+        auto& stream = *streams.streams.emplace_back(std::make_unique<stream_t>(
+          *this, streams.streams.size(), size, Buf == Buffering::Circular ? Overflow::Block : overflow, recovery));
+
+        // Publish the stream to lock-free readers. A full table is copied into a larger one, which is published before
+        // the count, so that a reader that sees the new count also sees a table that holds the new stream.
+        const auto index = streams.streams.size() - 1;
+        if (index == streams.capacity)
+        {
+            streams.capacity = std::max<size_t>(streams.capacity * 2, 16);
+            auto& table      = streams.tables.emplace_back(std::make_unique<stream_t*[]>(streams.capacity));
+            std::copy_n(streams.table.load(std::memory_order_relaxed), index, table.get());
+            streams.table.store(table.get(), std::memory_order_release);
+        }
+        streams.tables.back()[index] = &stream;
+        streams.count.store(streams.streams.size(), std::memory_order_release);
+
+        // Update the stream count in the format file right away if blocks of this stream can be read before the next
+        // write of the format file: without a writer thread, and in memory-mapped mode where committed blocks are
+        // visible immediately. Readers stop at the first block of a stream they do not know.
+        if (Buf == Buffering::Circular || log.settings.memoryMapped) writeFormats();
+
+        return stream;
     }
 
-    template<is_category_filter C, Ordering Order>
-    void Log<C, Order>::flush(stream_t& stream)
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    uint64_t Log<C, Order, Buf, Time>::getPoolExhaustedCount() const noexcept
     {
-        // Add to queue.
+        return buffer.exhausted.load(std::memory_order_relaxed);
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::setMinimumCategory(const uint32_t category) noexcept
+    {
+        static_assert(std::atomic_uint32_t::is_always_lock_free);
+        log.minimumCategory.store(category, std::memory_order_relaxed);
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    uint32_t Log<C, Order, Buf, Time>::getMinimumCategory() const noexcept
+    {
+        return log.minimumCategory.load(std::memory_order_relaxed);
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::dump() requires(Buf == Buffering::Circular)
+    {
+        std::scoped_lock lock(streams.mutex);
+
+        // Take a snapshot of all streams first, so that writing the file does not widen the window in which chunks
+        // can be overwritten.
+        constexpr LogFileHeader header;
+        std::vector<uint8_t>    data(sizeof header);
+        std::memcpy(data.data(), &header, sizeof header);
+        for (const auto& s : streams.streams) s->snapshot(data);
+
+        std::ofstream file(log.path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        file.close();
+        if (!file) throw LalError(std::format("Failed to write log file {}", log.path.string()));
+
+        writeFormats();
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::dumpOnSignal(void* context) noexcept
+    {
+        // Nothing here may allocate or lock. Streams that are being created at the time of the signal may be missed.
+        auto& self = *static_cast<Log*>(context);
+
+        if (const auto fd = openFileSignalSafe(self.log.path.c_str(), true); fd >= 0)
         {
-            std::scoped_lock lock(streams.mutex);
-            streams.queue.emplace_back(&stream);
+            constexpr LogFileHeader header;
+            writeFileSignalSafe(fd, &header, sizeof header);
+            // The vector of streams can be reallocated by createStream at any time, the published table cannot.
+            const auto  count = self.streams.count.load(std::memory_order_acquire);
+            const auto* table = self.streams.table.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; i++) table[i]->dump(fd);
+            closeFileSignalSafe(fd);
         }
 
-        // Notify processor.
+        if (const auto fd = openFileSignalSafe(self.log.fmtPath.c_str(), false); fd >= 0)
         {
-            // Note: Deliberately using unique_lock here. condition_variable is not compatible with scoped_lock.
-            std::unique_lock lock(processor.mutex);
-            processor.notified = true;
+            const auto header = self.formatHeader();
+            writeFileSignalSafe(fd, header.data(), header.size());
+            closeFileSignalSafe(fd);
         }
-        processor.cv.notify_one();
     }
 
-    template<is_category_filter C, Ordering Order>
-    void Log<C, Order>::process(const std::stop_token token)
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::flush(stream_t& stream)
     {
-        const auto swap = [this] {
-            // Wait to ensure back buffer has been flushed to file.
-            writer.doneSemaphore.acquire();
+        // Push onto queue. A stream cannot be in the queue more than once, since it waits
+        // for its previous back buffer to be processed before flushing again.
+        auto* head = streams.queue.load(std::memory_order_relaxed);
+        do {
+            stream.next = head;
+        } while (!streams.queue.compare_exchange_weak(head, &stream));
 
-            // Swap buffers.
-            std::swap(buffer.front, buffer.back);
-            buffer.used   = buffer.offset;
-            buffer.offset = 0;
+        // Notify processor, unless another stream already did so.
+        if (!processor.notified.exchange(true)) processor.notified.notify_one();
+    }
 
-            // Notify writer.
-            writer.signalSemaphore.release();
-        };
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    auto Log<C, Order, Buf, Time>::takeQueue() -> stream_t*
+    {
+        // Take the whole list at once and reverse it to restore flush order.
+        auto*     head = streams.queue.exchange(nullptr);
+        stream_t* q    = nullptr;
+        while (head)
+        {
+            auto* next = head->next;
+            head->next = q;
+            q          = head;
+            head       = next;
+        }
 
+        return q;
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::process(const std::stop_token token)
+    {
         do {
-            // Wait for work.
-            std::unique_lock lock(processor.mutex);
-            processor.cv.wait(lock, [&] { return processor.notified || token.stop_requested(); });
+            // Wait for work. Flag must be reset before taking the queue, so that streams queued after that wake us up again.
+            processor.notified.wait(false);
+            processor.notified = false;
+
+            processQueue(takeQueue());
+            if (processor.expired.exchange(false)) processIdle();
+
+            // Streams are waiting for their data to be written, so hand over the batch right away.
+            if (log.settings.zeroCopy && !buffer.pool[buffer.frontIndex].segments.empty()) swap();
+        } while (!token.stop_requested());
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::processQueue(stream_t* stream)
+    {
+        while (stream)
+        {
+            // Stream can be requeued as soon as it is released, which overwrites its next pointer.
+            auto* next = stream->next;
 
-            // Copy indices of all streams that need to be flushed.
-            std::vector<stream_t*> q;
+            if constexpr (Buf == Buffering::Double)
+            {
+                // Skip the part of the back buffer that was already taken while it was the front buffer.
+                const auto data = std::span(stream->buffer.back + stream->buffer.taken,
+                                            stream->buffer.used - stream->buffer.taken);
+                stream->buffer.taken = 0;
+                if (data.empty())
+                    release(*stream, 0);
+                else if (log.settings.zeroCopy)
+                    gatherBlock(*stream, 0, data);
+                else
+                {
+                    copyBlock(stream->index, data);
+                    release(*stream, 0);
+                }
+            }
+            else
             {
-                std::scoped_lock streamsLock(streams.mutex);
-                q = streams.queue;
-                streams.queue.clear();
+                // Allow stream to be queued again before reading committed, so that no flush is missed.
+                stream->ring.queued = false;
+                processCommitted(*stream);
             }
 
-            // Wait with unlock until queue was copied.
-            processor.notified = false;
-            lock.unlock();
+            stream = next;
+        }
+    }
 
-            for (auto* stream : q)
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::processCommitted(stream_t& stream)
+    {
+        const auto first = stream.ring.taken;
+        const auto last  = stream.ring.committed.load();
+        if (last > first)
+        {
+            const auto [part0, part1] = stream.ringData(first, last);
+            stream.ring.taken         = last;
+            if (log.settings.zeroCopy)
+                gatherBlock(stream, last, part0, part1);
+            else
             {
-                const auto* first = stream->buffer.back;
-                const auto* last  = first + stream->buffer.used;
-
-                // Write index of stream and size of block.
-                if (buffer.offset + sizeof(size_t) * 2 > buffer.size) swap();
-                *reinterpret_cast<size_t*>(buffer.front + buffer.offset)                  = stream->index;
-                *reinterpret_cast<size_t*>(buffer.front + buffer.offset + sizeof(size_t)) = stream->buffer.used;
-                buffer.offset += sizeof(size_t) * 2;
-                if (buffer.offset == buffer.size) swap();
+                copyBlock(stream.index, part0, part1);
+                release(stream, last);
+            }
+        }
+    }
 
-                // We might have to do multiple copies if the front buffer does not have enough space.
-                while (first < last)
-                {
-                    // Calculate how much can be copied this iteration.
-                    const auto copySize =
-                      std::min(static_cast<size_t>(std::distance(first, last)), buffer.size - buffer.offset);
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::processIdle()
+    {
+        // Take a snapshot of the streams from the published table instead of holding the mutex, which createStream
+        // would otherwise have to wait for while data is copied and buffers are handed to the writer. Streams are never
+        // removed, so the snapshot stays valid.
+        const auto  count = streams.count.load(std::memory_order_acquire);
+        const auto* table = streams.table.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; i++)
+        {
+            auto* s = table[i];
+            if (!s->committing) continue;
+
+            // Ask the stream to publish its write position with its next record, so that it can be taken at the next
+            // tick.
+            s->publish.store(true, std::memory_order_relaxed);
 
-                    // Copy to front buffer.
-                    std::copy(first, first + copySize, buffer.front + buffer.offset);
-                    buffer.offset += copySize;
-                    first += copySize;
+            if constexpr (Buf == Buffering::Double)
+            {
+                // Holding the flushed semaphore prevents the stream from swapping its buffers. If it is not available,
+                // a back buffer is pending and will be processed anyway.
+                if (!s->flushed.try_acquire()) continue;
 
-                    // Front buffer is full.
-                    if (buffer.offset == buffer.size) swap();
+                const auto first = s->buffer.taken;
+                const auto last  = s->buffer.committed.load(std::memory_order_acquire);
+                if (last > first)
+                {
+                    const auto data = std::span(s->buffer.front + first, last - first);
+                    s->buffer.taken = last;
+                    if (log.settings.zeroCopy)
+                    {
+                        gatherBlock(*s, 0, data);
+                        continue;
+                    }
+                    copyBlock(s->index, data);
                 }
+                release(*s, 0);
+            }
+            else
+                processCommitted(*s);
+        }
+
+        // Hand partially filled global buffer to the writer. Direct I/O can only write whole blocks, and memory-mapped
+        // data is already in the page cache, only its formats need to be written.
+        if (log.settings.memoryMapped)
+            writeFormats();
+        else if (buffer.offset > 0 && !log.settings.directIo)
+            swap();
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::tick(const std::stop_token token)
+    {
+        std::mutex                  mutex;
+        std::condition_variable_any cv;
+        std::unique_lock            lock(mutex);
+        const auto                  interval = log.settings.maxFlushLatency / 2;
+
+        while (!cv.wait_for(lock, token, interval, [] { return false; }) && !token.stop_requested())
+        {
+            processor.expired = true;
+            if (!processor.notified.exchange(true)) processor.notified.notify_one();
+        }
+    }
 
-                // Signal to stream that flush is done.
-                stream->flushed.release();
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::processRemaining(stream_t& stream)
+    {
+        if constexpr (Buf == Buffering::Double)
+        {
+            if (stream.buffer.offset > stream.buffer.taken)
+            {
+                const auto data =
+                  std::span(stream.buffer.front + stream.buffer.taken, stream.buffer.offset - stream.buffer.taken);
+                if (log.settings.zeroCopy)
+                    gatherBlock(stream, 0, data);
+                else
+                    copyBlock(stream.index, data);
             }
-        } while (!token.stop_requested());
+        }
+        else
+        {
+            // Take everything that was not taken yet, whether it was handed to the log or not.
+            const auto first = stream.ring.taken;
+            const auto last  = stream.ring.head;
+            if (last > first)
+            {
+                const auto [part0, part1] = stream.ringData(first, last);
+                stream.ring.taken         = last;
+                if (log.settings.zeroCopy)
+                    gatherBlock(stream, last, part0, part1);
+                else
+                    copyBlock(stream.index, part0, part1);
+            }
+        }
     }
 
-    template<is_category_filter C, Ordering Order>
-    void Log<C, Order>::write(const std::stop_token token)
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::swap()
     {
-        do {
-            // Wait for work.
-            writer.signalSemaphore.acquire();
+        if (log.settings.memoryMapped)
+        {
+            // Release completed chunk and map the next one. Keep the file offset advancing if mapping fails, so that
+            // later chunks still end up in the right place.
+            if (buffer.front != buffer.pool.front().data) writer.mapped->unmap(buffer.front, buffer.size);
+            writeFormats();
+            writer.offset += buffer.size;
+            buffer.front  = writer.mapped->map(writer.offset, buffer.size);
+            if (!buffer.front) buffer.front = buffer.pool.front().data;
+            buffer.offset = 0;
+            return;
+        }
 
-            // Write back buffer to file.
-            if (log.file.good()) log.file.write(reinterpret_cast<const char*>(buffer.back), buffer.used);
-            buffer.used = 0;
+        // Hand front buffer to writer.
+        buffer.pool[buffer.frontIndex].used                       = buffer.offset;
+        writer.readyList[writer.readyPush++ % buffer.pool.size()] = buffer.frontIndex;
+        writer.readySemaphore.release();
 
-            // Signal back buffer flush done.
-            writer.doneSemaphore.release();
-        } while (!token.stop_requested());
+        // Take a free buffer, waiting for the writer if there is none.
+        if (!writer.freeSemaphore.try_acquire())
+        {
+            buffer.exhausted.fetch_add(1, std::memory_order_relaxed);
+            writer.freeSemaphore.acquire();
+        }
+        buffer.frontIndex = writer.freeList[writer.freePop++ % buffer.pool.size()];
+        buffer.front      = buffer.pool[buffer.frontIndex].data;
+        buffer.offset     = 0;
     }
 
-    template<is_category_filter C, Ordering Order>
-    template<typename F, typename... Ts>
-    void Log<C, Order>::registerFormat(const MessageKey key)
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::writeFileHeader()
     {
-        static std::atomic_bool visited(false);
+        constexpr LogFileHeader header;
+        std::memcpy(buffer.front + buffer.offset, &header, sizeof header);
+        if (log.settings.zeroCopy) buffer.pool[buffer.frontIndex].segments.push_back({buffer.front, sizeof header});
+        buffer.offset += sizeof header;
+    }
 
-        if (bool b = false; visited.compare_exchange_strong(b, true))
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::copyBlock(const size_t                   index,
+                                       const std::span<const uint8_t> first,
+                                       const std::span<const uint8_t> second)
+    {
+        // Index of stream and size of block. Copied like the data itself, so that every buffer except the last is
+        // filled completely, which direct I/O relies on. In memory-mapped mode, the first byte of the size is written
+        // once the whole block was copied and serves as commit marker: a block that was torn by a crash of the process
+        // has size 0, which readers treat as the end of the log. Outside of memory-mapped mode, the writer offset
+        // belongs to the writer thread and must not be read here.
+        const auto                              mapped = log.settings.memoryMapped;
+        const auto                              size   = first.size() + second.size();
+        std::array<uint8_t, maxBlockHeaderSize> header;
+        const auto                              indexSize  = encodeVarint(index, header.data());
+        const auto                              headerSize = indexSize + encodeVarint(size, header.data() + indexSize);
+        const auto                              marker     = header[indexSize];
+        if (mapped) header[indexSize] = 0;
+        const std::span<const uint8_t> headerBytes(header.data(), headerSize);
+        const auto                     sizeOffset  = mapped ? writer.offset + buffer.offset + indexSize : 0;
+        const auto                     committable = buffer.front != buffer.pool.front().data;
+
+        // Committed blocks are visible to readers right away, so the formats they use must be written first. Formats
+        // are registered before a stream writes the first record that uses them.
+        if (mapped && hasUnwrittenFormats()) writeFormats();
+
+        for (auto part : {headerBytes, first, second})
         {
-            std::scoped_lock lock(log.mutex);
+            // We might have to do multiple copies if the front buffer does not have enough space.
+            while (!part.empty())
+            {
+                // Calculate how much can be copied this iteration.
+                const auto copySize = std::min(part.size(), buffer.size - buffer.offset);
 
-            // Hash types.
-            decltype(FormatType::parameters) types = {hashParameter<Ts>()...};
+                // Copy to front buffer.
+                std::copy(part.begin(), part.begin() + copySize, buffer.front + buffer.offset);
+                buffer.offset += copySize;
+                part = part.subspan(copySize);
 
-            // Store format and type information.
-            log.formats.try_emplace(key, std::string(F::message), F::category, std::move(types));
+                // Front buffer is full.
+                if (buffer.offset == buffer.size) swap();
+            }
+        }
+
+        // Commit block, unless its header went to the fallback buffer. If the marker is not within the current chunk,
+        // that chunk was already unmapped.
+        if (mapped && committable)
+        {
+            std::atomic_thread_fence(std::memory_order_release);
+            if (sizeOffset >= writer.offset && buffer.front != buffer.pool.front().data)
+                buffer.front[sizeOffset - writer.offset] = marker;
+            else
+                writer.mapped->write(sizeOffset, &marker, sizeof marker);
         }
     }
 
-    template<is_category_filter C, Ordering Order>
-    template<MessageKey K>
-    void Log<C, Order>::registerSourceLocation(const std::source_location& loc)
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::gatherBlock(stream_t&                      stream,
+                                         const size_t                   position,
+                                         const std::span<const uint8_t> first,
+                                         const std::span<const uint8_t> second)
     {
-        static std::atomic_bool visited(false);
+        // Write index of stream and size of block. Header must stay in place until the batch is written.
+        if (buffer.offset + maxBlockHeaderSize > buffer.size) swap();
+        auto*      header     = buffer.front + buffer.offset;
+        const auto headerSize = encodeBlockHeader(stream.index, first.size() + second.size(), header);
+        buffer.offset += headerSize;
+
+        // Reference stream data directly.
+        auto& front = buffer.pool[buffer.frontIndex];
+        front.segments.push_back({header, headerSize});
+        if (!first.empty()) front.segments.push_back({first.data(), first.size()});
+        if (!second.empty()) front.segments.push_back({second.data(), second.size()});
+        front.streams.emplace_back(&stream, position);
+    }
 
-        if (bool b = false; visited.compare_exchange_strong(b, true))
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::release(stream_t& stream, const size_t position)
+    {
+        if constexpr (Buf == Buffering::Double)
+        {
+            // Signal to stream that flush is done.
+            stream.flushed.release();
+        }
+        else
         {
-            std::scoped_lock lock(log.mutex);
+            // Signal to stream that space was freed.
+            stream.ring.consumed = position;
+            stream.ring.consumed.notify_one();
+        }
+    }
 
-            decltype(FormatType::parameters) types = {};
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::write(const std::stop_token token)
+    {
+        while (true)
+        {
+            // Retire writes that completed, so that their buffers are free again while other buffers are still waiting
+            // to be written.
+            while (const auto index = writer.backend->poll()) completeWrite(*index);
 
-            log.formats.try_emplace(
-              K, std::string(loc.file_name()) + std::format("({},{})", loc.line(), loc.column()), 0, types);
+            // Wait for work. While writes are in flight, wait for those to complete until a buffer is ready.
+            auto ready = writer.readySemaphore.try_acquire();
+            while (!ready && !writer.inFlight.empty())
+            {
+                completeWrite(writer.backend->wait());
+                ready = writer.readySemaphore.try_acquire();
+            }
+            if (!ready) writer.readySemaphore.acquire();
+
+            // Stop is only requested after all buffers were written.
+            if (token.stop_requested()) break;
+
+            // Formats must be on disk before the messages that use them.
+            writeFormats();
+
+            const auto index = writer.readyList[writer.readyPop++ % buffer.pool.size()];
+            auto&      b     = buffer.pool[index];
+            if (log.settings.zeroCopy)
+            {
+                // Write batch of headers and stream data.
+                const auto size = std::accumulate(
+                  b.segments.begin(), b.segments.end(), uint64_t{0}, [](const uint64_t sum, const WriteSegment& seg) {
+                      return sum + seg.size;
+                  });
+                writer.backend->submit(writer.offset, b.segments, index);
+                writer.offset += size;
+            }
+            else
+            {
+                // Write buffer contents.
+                writer.backend->submit(writer.offset, b.data, b.used, index);
+                writer.offset += b.used;
+            }
+            writer.inFlight.push_back(index);
         }
     }
 
-    template<is_category_filter C, Ordering Order>
-    void Log<C, Order>::writeFormats()
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::completeWrite(const size_t index)
     {
-        // Open formats file.
-        auto fmtPath = log.path;
-        fmtPath += ".fmt";
-        auto fmtFile = std::ofstream(fmtPath, std::ios::binary);
+        buffer.pool[index].written = true;
 
-        if (!fmtFile) throw LalError(std::format("Failed to open format file {}", fmtPath.string()));
+        // Retire buffers in submission order.
+        while (!writer.inFlight.empty() && buffer.pool[writer.inFlight.front()].written)
+        {
+            const auto front = writer.inFlight.front();
+            writer.inFlight.pop_front();
+
+            // Release all streams in zero-copy batch.
+            auto& b = buffer.pool[front];
+            for (const auto& [stream, position] : b.streams) release(*stream, position);
+            b.streams.clear();
+            b.segments.clear();
+            b.used    = 0;
+            b.written = false;
+
+            // Return buffer to free list.
+            writer.freeList[writer.freePush++ % buffer.pool.size()] = front;
+            writer.freeSemaphore.release();
+        }
+    }
 
-        // Write number of streams.
-        auto streamCount = streams.streams.size();
-        fmtFile.write(reinterpret_cast<const char*>(&streamCount), sizeof streamCount);
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    template<uint32_t K>
+    bool Log<C, Order, Buf, Time>::registerSourceLocation(const std::source_location& loc)
+    {
+        static SourceRegistrar<Log> registrar(MessageKey{K}, loc);
 
-        // Write message order setting.
-        fmtFile << (Order == Ordering::Enabled ? static_cast<uint8_t>(1) : static_cast<uint8_t>(0));
+        // Update the format file right away if records that use this source location can end up in a log file without
+        // the writer or processor thread, i.e. by a dump from a signal handler or by recoverLog. Other logs of this
+        // type pick up the source location with their next format file update.
+        if (Buf == Buffering::Circular || log.settings.recoverable) writeFormats();
+        return true;
+    }
 
-        // Write all formats.
-        for (const auto& [key, format] : log.formats)
-        {
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::writeFormats()
+    {
+        std::scoped_lock lock(log.fmtMutex);
+        auto&            fmtFile = log.fmtFile;
+
+        // Rewrite the header, which has a fixed size.
+        const auto header = formatHeader();
+        fmtFile.seekp(0);
+        fmtFile.write(reinterpret_cast<const char*>(header.data()), header.size());
+        fmtFile.seekp(0, std::ios::end);
+
+        // Write a single format.
+        const auto writeFormat = [&fmtFile](const MessageKey              key,
+                                            const std::string_view        message,
+                                            const uint32_t                category,
+                                            std::span<const ParameterKey> parameters,
+                                            std::span<const bool>         variable) {
             // Write key.
             fmtFile.write(reinterpret_cast<const char*>(&key), sizeof MessageKey);
 
             // Write format string.
-            const auto length = format.message.size() + 1;
+            const auto length = message.size() + 1;
             fmtFile.write(reinterpret_cast<const char*>(&length), sizeof length);
-            fmtFile.write(format.message.c_str(), length);
+            fmtFile.write(message.data(), static_cast<std::streamsize>(message.size()));
+            fmtFile.put('\0');
 
             // Write category.
-            fmtFile.write(reinterpret_cast<const char*>(&format.category), sizeof format.category);
+            fmtFile.write(reinterpret_cast<const char*>(&category), sizeof category);
 
             // Write parameter information.
-            for (const auto p : format.parameters)
-                fmtFile.write(reinterpret_cast<const char*>(&p), sizeof ParameterKey);
+            for (size_t i = 0; i < parameters.size(); i++)
+            {
+                fmtFile.write(reinterpret_cast<const char*>(&parameters[i]), sizeof ParameterKey);
+                fmtFile.put(static_cast<char>(variable[i]));
+            }
+        };
+
+        // Write all formats that streams of this log type can write and that were not written yet. New formats are
+        // pushed onto the front of the registry, so stop at the last written one. This may include formats that are
+        // only used by other log objects of the same type.
+        const auto* head = formatRegistry<Log>.front();
+        for (auto format = head; format != log.writtenFormat.load(std::memory_order_relaxed); format = format->next)
+            writeFormat(format->key, format->message, format->category, format->parameters, format->variable);
+
+        // Hand to the OS, so that the format file survives a crash of the process. Only then mark the formats as
+        // written, so that hasUnwrittenFormats does not skip formats that are still being written by another thread.
+        fmtFile.flush();
+        log.writtenFormat.store(head, std::memory_order_release);
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    bool Log<C, Order, Buf, Time>::hasUnwrittenFormats() const noexcept
+    {
+        return formatRegistry<Log>.front() != log.writtenFormat.load(std::memory_order_acquire);
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Log<C, Order, Buf, Time>::closeFormats()
+    {
+        if constexpr (Time == Timestamps::Tsc)
+        {
+            // Measure the tick rate over at least 10ms.
+            static constexpr auto minimum = std::chrono::milliseconds(10);
+            if (const auto elapsed = std::chrono::steady_clock::now() - clock.steady; elapsed < minimum)
+                std::this_thread::sleep_for(minimum - elapsed);
         }
+        writeFormats();
+        log.fmtFile.close();
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    auto Log<C, Order, Buf, Time>::formatHeader() const noexcept -> std::array<uint8_t, formatHeaderSize>
+    {
+        std::array<uint8_t, formatHeaderSize> header{};
+        auto*                                 out   = header.data();
+        const auto                            write = [&out](const auto& value) {
+            std::memcpy(out, &value, sizeof value);
+            out += sizeof value;
+        };
+
+        // Write magic and version.
+        write(FormatFileHeader{});
+
+        // Write number of streams.
+        write(streams.count.load(std::memory_order_acquire));
+
+        // Write message order setting.
+        write(static_cast<uint8_t>(Order));
+
+        // Write timestamp source and calibration.
+        write(static_cast<uint8_t>(Time));
+        if constexpr (Time != Timestamps::Disabled)
+        {
+            Calibration calibration{.source = Time, .anchorTicks = clock.ticks, .anchorNs = clock.system};
+
+            if constexpr (Time == Timestamps::Tsc)
+            {
+                // Measure the tick rate against the steady clock over the lifetime of the log so far.
+                const auto ticks = readTimestamp<Time>();
+                const auto ns    = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now() - clock.steady)
+                                  .count();
+                calibration.ticksPerNs =
+                  static_cast<double>(ticks - clock.ticks) / static_cast<double>(std::max<int64_t>(ns, 1));
+            }
+
+            write(calibration.ticksPerNs);
+            write(calibration.anchorTicks);
+            write(calibration.anchorNs);
+        }
+
+        return header;
     }
 }  // namespace lal
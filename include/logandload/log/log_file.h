@@ -0,0 +1,117 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <span>
+
+namespace lal
+{
+    /**
+     * \brief Header at the start of a log file, followed by the blocks. Each block starts with the stream index and
+     * the block size, which are stored as unsigned LEB128 varints. Log files of version 1 have no header and store
+     * both values as size_t.
+     */
+    struct LogFileHeader
+    {
+        static constexpr uint64_t currentMagic   = 0x0000474f4c4c414c;  // "LALLOG\0\0"
+        static constexpr uint32_t currentVersion = 2;
+
+        uint64_t magic   = currentMagic;
+        uint32_t version = currentVersion;
+
+        /**
+         * \brief Reserved, always 0.
+         */
+        uint32_t flags = 0;
+    };
+
+    static_assert(sizeof(LogFileHeader) == 16);
+
+    /**
+     * \brief Maximum size of an encoded block header.
+     */
+    constexpr size_t maxBlockHeaderSize = 20;
+
+    /**
+     * \brief Encode a value as unsigned LEB128 varint.
+     * \param value Value.
+     * \param out Output buffer of at least 10 bytes.
+     * \return Number of bytes written.
+     */
+    [[nodiscard]] constexpr size_t encodeVarint(uint64_t value, uint8_t* out) noexcept
+    {
+        size_t size = 0;
+        while (value >= 0x80)
+        {
+            out[size++] = static_cast<uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        out[size++] = static_cast<uint8_t>(value);
+        return size;
+    }
+
+    /**
+     * \brief Encode a block header. The first byte of the block size is never 0, since blocks are never empty.
+     * \param index Stream index.
+     * \param size Block size.
+     * \param out Output buffer of at least maxBlockHeaderSize bytes.
+     * \return Number of bytes written.
+     */
+    [[nodiscard]] constexpr size_t encodeBlockHeader(const size_t index, const size_t size, uint8_t* out) noexcept
+    {
+        const auto indexSize = encodeVarint(index, out);
+        return indexSize + encodeVarint(size, out + indexSize);
+    }
+
+    /**
+     * \brief Get the version of a log file from its first bytes.
+     * \param data Start of log file.
+     * \return Version. 1 if there is no file header.
+     * \throws LalError If the version is not supported.
+     */
+    [[nodiscard]] uint32_t decodeLogFileHeader(std::span<const std::byte> data);
+
+    /**
+     * \brief Read the version of a log file. Afterwards, the stream is positioned at the first block.
+     * \param in Stream positioned at the start of the log file.
+     * \return Version. 1 if there is no file header.
+     * \throws LalError If the version is not supported.
+     */
+    [[nodiscard]] uint32_t readLogFileHeader(std::istream& in);
+
+    /**
+     * \brief Get the size of the file header of a log file.
+     * \param version Version.
+     * \return Size in bytes.
+     */
+    [[nodiscard]] constexpr size_t logFileHeaderSize(const uint32_t version) noexcept
+    {
+        return version == 1 ? 0 : sizeof(LogFileHeader);
+    }
+
+    /**
+     * \brief Decode a block header.
+     * \param data Data starting at the block header.
+     * \param version Log file version.
+     * \param index Stream index.
+     * \param size Block size.
+     * \return Size of the block header, or 0 if data ends within it or it is malformed.
+     */
+    [[nodiscard]] size_t
+      decodeBlockHeader(std::span<const std::byte> data, uint32_t version, size_t& index, size_t& size) noexcept;
+
+    /**
+     * \brief Read a block header.
+     * \param in Stream positioned at the block header.
+     * \param version Log file version.
+     * \param index Stream index.
+     * \param size Block size.
+     * \return True on success, false if the stream ends within the header or it is malformed.
+     */
+    bool readBlockHeader(std::istream& in, uint32_t version, size_t& index, size_t& size);
+}  // namespace lal
@@ -0,0 +1,101 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace lal
+{
+    /**
+     * \brief Alignment of buffers, file offsets and write sizes in direct I/O mode.
+     */
+    constexpr size_t directIoAlignment = 4096;
+
+    enum class WriterBackend : uint8_t
+    {
+        /**
+         * \brief Blocking pwrite/pwritev on the writer thread.
+         */
+        Pwrite = 0,
+
+        /**
+         * \brief Asynchronous writes through io_uring. Falls back to Pwrite if io_uring is not available.
+         */
+        IoUring = 1
+    };
+
+    /**
+     * \brief Runtime settings of a Log.
+     */
+    struct LogSettings
+    {
+        /**
+         * \brief If true, stream buffers are not copied to a global buffer. Instead, the writer thread writes them
+         * directly to the log file, together with the block headers, using a single gathered write. Streams are
+         * released once the write completes.
+         */
+        bool zeroCopy = false;
+
+        /**
+         * \brief Backend used by the writer thread.
+         */
+        WriterBackend writerBackend = WriterBackend::Pwrite;
+
+        /**
+         * \brief Maximum number of writes the io_uring backend keeps in flight.
+         */
+        uint32_t queueDepth = 8;
+
+        /**
+         * \brief Number of global buffers. Must be at least 2. One buffer is filled by the processor thread while the
+         * others are being written or free. More buffers absorb short stalls of the disk.
+         */
+        size_t bufferCount = 2;
+
+        /**
+         * \brief If true, the log file is opened for direct I/O (O_DIRECT), bypassing the page cache. Global buffers
+         * are then aligned to and written in multiples of directIoAlignment. The global buffer size must be a multiple
+         * of directIoAlignment. The final partial block is padded and the file is truncated to its true length when
+         * the Log is destroyed. Cannot be combined with zeroCopy.
+         */
+        bool directIo = false;
+
+        /**
+         * \brief If true, the log file is grown in chunks of the global buffer size, which are memory-mapped. The
+         * processor thread copies stream data straight into the mapping and there is no writer thread. Data becomes
+         * visible to other processes as soon as it is copied. The global buffer size must be a multiple of the page
+         * size. Cannot be combined with zeroCopy or directIo. Not supported on Windows. Each block is committed by
+         * writing its size last, so that a block that was torn by a crash of the process has size 0.
+         */
+        bool memoryMapped = false;
+
+        /**
+         * \brief If true, stream buffers are placed in a file-backed mapping at log_path + ".rec", so that records that
+         * did not make it to the log file yet survive a crash of the process. recoverLog then appends them to the log
+         * file. The recovery file is removed when the Log is destroyed. Requires memoryMapped. Not supported on Windows.
+         */
+        bool recoverable = false;
+
+        /**
+         * \brief Maximum time a record stays in memory before it is handed to the writer. Zero disables the limit, in
+         * which case stream buffers are only taken when they are flushed. Otherwise, a timer wakes the processor thread
+         * at half this interval to take the records of idle streams and hand a partially filled global buffer to the
+         * writer. At each tick, streams are asked to publish their write position with their next record, so records
+         * of a stream that writes rarely are taken at the following tick. Records that a stream writes after it
+         * published are taken once it publishes again, flushes or is destroyed. Streams cannot use the DropBuffer
+         * policy, because their data can still be discarded. With direct I/O, only full global buffers are written
+         * before the Log is destroyed.
+         */
+        std::chrono::milliseconds maxFlushLatency{0};
+
+        /**
+         * \brief If true, a flight recorder (Buffering::Circular) dumps its streams when the process receives a fatal
+         * signal. See addFatalSignalCallback.
+         */
+        bool dumpOnFatalSignal = true;
+    };
+}  // namespace lal
@@ -0,0 +1,98 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace lal
+{
+    /**
+     * \brief Output file that is written through memory-mapped chunks. The file is grown one chunk at a time. Only
+     * functional on POSIX platforms.
+     */
+    class MappedFile
+    {
+    public:
+        ////////////////////////////////////////////////////////////////
+        // Constructors.
+        ////////////////////////////////////////////////////////////////
+
+        MappedFile() = delete;
+
+        /**
+         * \brief Open a file. Check good() to see if this succeeded.
+         * \param path Path to file. Existing contents are discarded.
+         */
+        explicit MappedFile(const std::filesystem::path& path);
+
+        MappedFile(const MappedFile&) = delete;
+
+        MappedFile(MappedFile&&) = delete;
+
+        ~MappedFile() noexcept;
+
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        MappedFile& operator=(MappedFile&&) = delete;
+
+        ////////////////////////////////////////////////////////////////
+        // Getters.
+        ////////////////////////////////////////////////////////////////
+
+        /**
+         * \brief Returns whether the file was opened successfully.
+         * \return True or false.
+         */
+        [[nodiscard]] bool good() const noexcept;
+
+        /**
+         * \brief Get the granularity of mappings. Chunk offsets and sizes must be a multiple of this.
+         * \return Granularity in bytes.
+         */
+        [[nodiscard]] static size_t granularity() noexcept;
+
+        ////////////////////////////////////////////////////////////////
+        // Mapping.
+        ////////////////////////////////////////////////////////////////
+
+        /**
+         * \brief Grow the file to offset + size bytes and map that chunk.
+         * \param offset Offset of chunk in file.
+         * \param size Size of chunk.
+         * \return Pointer to mapped chunk, or nullptr on failure.
+         */
+        [[nodiscard]] uint8_t* map(uint64_t offset, size_t size);
+
+        /**
+         * \brief Start writeback of a completed chunk, drop its pages and unmap it.
+         * \param data Pointer returned by map.
+         * \param size Size of chunk.
+         */
+        void unmap(uint8_t* data, size_t size);
+
+        /**
+         * \brief Write data to the file without going through a mapping, e.g. to a chunk that was already unmapped.
+         * \param offset Offset in file.
+         * \param data Data.
+         * \param size Size in bytes.
+         */
+        void write(uint64_t offset, const void* data, size_t size);
+
+        /**
+         * \brief Truncate the file to its final size.
+         * \param size Size in bytes.
+         */
+        void truncate(uint64_t size);
+
+    private:
+        ////////////////////////////////////////////////////////////////
+        // Member variables.
+        ////////////////////////////////////////////////////////////////
+
+        int fd = -1;
+    };
+}  // namespace lal
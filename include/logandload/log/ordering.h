@@ -10,7 +10,20 @@ namespace lal
 {
     enum class Ordering : uint8_t
     {
+        /**
+         * \brief Messages are only ordered within their stream.
+         */
         Disabled = 0,
-        Enabled  = 1
+
+        /**
+         * \brief Each message takes a unique index from a counter that is shared by all streams.
+         */
+        Enabled = 1,
+
+        /**
+         * \brief Messages are ordered by their timestamp, ties are broken by stream index. Nothing is shared between
+         * streams while logging. The index is reconstructed when reading the log. Requires timestamps.
+         */
+        Timestamp = 2
     };
 }  // namespace lal
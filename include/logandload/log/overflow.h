@@ -0,0 +1,31 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+
+namespace lal
+{
+    /**
+     * \brief What a stream does when its buffer is full and the log has not yet taken the previous data.
+     */
+    enum class Overflow : uint8_t
+    {
+        /**
+         * \brief Wait for the log.
+         */
+        Block = 0,
+
+        /**
+         * \brief Drop the message that does not fit.
+         */
+        DropNewest = 1,
+
+        /**
+         * \brief Drop all data that was not yet handed to the log, making room for new messages.
+         */
+        DropBuffer = 2
+    };
+}  // namespace lal
@@ -0,0 +1,86 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <deque>
+#include <fstream>
+
+////////////////////////////////////////////////////////////////
+// Current target includes.
+////////////////////////////////////////////////////////////////
+
+#include "logandload/log/writer_backend.h"
+
+namespace lal
+{
+    /**
+     * \brief Writer backend that completes every write on submission with pwrite/pwritev. Uses std::ofstream on
+     * platforms without these functions.
+     */
+    class PwriteBackend final : public IWriterBackend
+    {
+    public:
+        ////////////////////////////////////////////////////////////////
+        // Constructors.
+        ////////////////////////////////////////////////////////////////
+
+        PwriteBackend() = delete;
+
+        /**
+         * \brief Open a file. Check good() to see if this succeeded.
+         * \param path Path to file. Existing contents are discarded.
+         * \param direct If true, bypass the page cache. All writes must then be aligned to directIoAlignment.
+         */
+        PwriteBackend(const std::filesystem::path& path, bool direct);
+
+        PwriteBackend(const PwriteBackend&) = delete;
+
+        PwriteBackend(PwriteBackend&&) = delete;
+
+        ~PwriteBackend() noexcept override;
+
+        PwriteBackend& operator=(const PwriteBackend&) = delete;
+
+        PwriteBackend& operator=(PwriteBackend&&) = delete;
+
+        ////////////////////////////////////////////////////////////////
+        // Getters.
+        ////////////////////////////////////////////////////////////////
+
+        [[nodiscard]] bool good() const noexcept override;
+
+        [[nodiscard]] size_t pending() const noexcept override;
+
+        ////////////////////////////////////////////////////////////////
+        // Writing.
+        ////////////////////////////////////////////////////////////////
+
+        void submit(uint64_t offset, const void* data, size_t size, size_t tag) override;
+
+        void submit(uint64_t offset, std::span<WriteSegment> segments, size_t tag) override;
+
+        size_t wait() override;
+
+        [[nodiscard]] std::optional<size_t> poll() override;
+
+    private:
+        ////////////////////////////////////////////////////////////////
+        // Member variables.
+        ////////////////////////////////////////////////////////////////
+
+#ifdef WIN32
+        std::ofstream stream;
+#else
+        int fd = -1;
+#endif
+
+        bool ok = false;
+
+        /**
+         * \brief Tags of completed writes that were not yet returned by wait.
+         */
+        std::deque<size_t> completed;
+    };
+}  // namespace lal
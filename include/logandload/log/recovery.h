@@ -0,0 +1,168 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <utility>
+#include <vector>
+
+////////////////////////////////////////////////////////////////
+// Current target includes.
+////////////////////////////////////////////////////////////////
+
+#include "logandload/log/buffering.h"
+#include "logandload/log/mapped_file.h"
+
+namespace lal
+{
+    /**
+     * \brief Header of the region of a single stream in a recovery file, followed by the stream's buffers. Lives in
+     * shared memory, so that it survives a crash of the process.
+     */
+    struct RecoveryStream
+    {
+        /**
+         * \brief Size of this header. Buffers follow at this offset, each aligned to 64 bytes.
+         */
+        static constexpr size_t headerSize = 64;
+
+        /**
+         * \brief Index of stream in log's list of streams.
+         */
+        uint64_t index = 0;
+
+        /**
+         * \brief Size of each buffer in bytes.
+         */
+        uint64_t size = 0;
+
+        /**
+         * \brief Number of buffers. 2 with Buffering::Double, 1 with Buffering::Ring.
+         */
+        uint64_t count = 0;
+
+        /**
+         * \brief Size of the region of this stream in the recovery file, including this header.
+         */
+        uint64_t regionSize = 0;
+
+        /**
+         * \brief Stream position (total number of bytes the stream wrote before) of the first byte in each buffer.
+         * Unused with Buffering::Ring, where ring positions are stream positions.
+         */
+        std::array<std::atomic_uint64_t, 2> start;
+
+        /**
+         * \brief Number of bytes at the start of each buffer that contain complete records. With Buffering::Ring,
+         * used[0] is the ring position up to which records are complete.
+         */
+        std::array<std::atomic_uint64_t, 2> used;
+
+        /**
+         * \brief Get a buffer.
+         * \param i Buffer index.
+         * \return Buffer data.
+         */
+        [[nodiscard]] uint8_t* data(const size_t i) noexcept
+        {
+            return reinterpret_cast<uint8_t*>(this) + headerSize + i * ((size + 63) / 64 * 64);
+        }
+    };
+
+    static_assert(sizeof(RecoveryStream) <= RecoveryStream::headerSize);
+
+    /**
+     * \brief File-backed mapping that holds the buffers of all streams of a log, so that data that was not written to
+     * the log file yet can be recovered after a crash of the process. Only functional on POSIX platforms.
+     */
+    class RecoveryFile
+    {
+    public:
+        ////////////////////////////////////////////////////////////////
+        // Constructors.
+        ////////////////////////////////////////////////////////////////
+
+        RecoveryFile() = delete;
+
+        /**
+         * \brief Create a recovery file. Check good() to see if this succeeded.
+         * \param path Path to file. Existing contents are discarded.
+         * \param buffering Buffering mode of the streams.
+         */
+        RecoveryFile(const std::filesystem::path& path, Buffering buffering);
+
+        RecoveryFile(const RecoveryFile&) = delete;
+
+        RecoveryFile(RecoveryFile&&) = delete;
+
+        /**
+         * \brief Unmap all streams. Does not remove the file.
+         */
+        ~RecoveryFile() noexcept;
+
+        RecoveryFile& operator=(const RecoveryFile&) = delete;
+
+        RecoveryFile& operator=(RecoveryFile&&) = delete;
+
+        ////////////////////////////////////////////////////////////////
+        // Getters.
+        ////////////////////////////////////////////////////////////////
+
+        /**
+         * \brief Returns whether the file was created successfully.
+         * \return True or false.
+         */
+        [[nodiscard]] bool good() const noexcept;
+
+        ////////////////////////////////////////////////////////////////
+        // Streams.
+        ////////////////////////////////////////////////////////////////
+
+        /**
+         * \brief Append the region of a new stream to the file. Streams must be added in index order.
+         * \param index Stream index.
+         * \param size Size of each buffer in bytes.
+         * \param count Number of buffers.
+         * \return Stream region, or nullptr on failure.
+         */
+        [[nodiscard]] RecoveryStream* addStream(size_t index, size_t size, size_t count);
+
+    private:
+        ////////////////////////////////////////////////////////////////
+        // Member variables.
+        ////////////////////////////////////////////////////////////////
+
+        MappedFile file;
+
+        /**
+         * \brief Mapped file header.
+         */
+        uint8_t* header = nullptr;
+
+        /**
+         * \brief File offset of the next stream region.
+         */
+        uint64_t offset = 0;
+
+        /**
+         * \brief Mapped stream regions.
+         */
+        std::vector<std::pair<uint8_t*, size_t>> regions;
+    };
+
+    /**
+     * \brief Recover a log after a crash of the process that wrote it. The log file is cut off at the first block that
+     * was not committed, after which the data that was still in the buffers of its streams is appended. Afterwards, the
+     * recovery file is removed and the log can be read as usual.
+     * \param path Path to log file. The recovery file is read from log_path + ".rec".
+     * \return Number of bytes of stream data that were recovered.
+     * \throws LalError If the recovery file is missing or invalid, or the log could not be written.
+     */
+    uint64_t recoverLog(const std::filesystem::path& path);
+}  // namespace lal
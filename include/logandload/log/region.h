@@ -17,30 +17,15 @@ namespace lal
     public:
         Region() = delete;
 
-        explicit Region(stream_t& s) : s(s)
-        {
-            static constexpr size_t messageSize = sizeof(MessageKey);
-            s.checkFlush(messageSize);
-            s << MessageTypes::AnonymousRegionStart;
-        }
+        explicit Region(stream_t& s) : s(s) { s.regionStart(MessageTypes::AnonymousRegionStart); }
 
-        Region(stream_t& s, const MessageKey key) : s(s)
-        {
-            static constexpr size_t messageSize = sizeof(MessageKey) * 2;
-            s.checkFlush(messageSize);
-            s << MessageTypes::NamedRegionStart << key;
-        }
+        Region(stream_t& s, const MessageKey key) : s(s) { s.regionStart(key); }
 
         Region(const Region&) = delete;
 
         Region(Region&&) = delete;
 
-        ~Region() noexcept
-        {
-            static constexpr size_t messageSize = sizeof(MessageKey);
-            s.checkFlush(messageSize);
-            s << MessageTypes::RegionEnd;
-        }
+        ~Region() noexcept { s.regionEnd(); }
 
         Region& operator=(const Region&) = delete;
 
@@ -57,19 +42,9 @@ namespace lal
     public:
         MovableRegion() = delete;
 
-        explicit MovableRegion(stream_t& s) : s(s)
-        {
-            static constexpr size_t messageSize = sizeof(MessageKey);
-            s.checkFlush(messageSize);
-            s << MessageTypes::AnonymousRegionStart;
-        }
+        explicit MovableRegion(stream_t& s) : s(s) { s.regionStart(MessageTypes::AnonymousRegionStart); }
 
-        MovableRegion(stream_t& s, const MessageKey key) : s(s)
-        {
-            static constexpr size_t messageSize = sizeof(MessageKey) * 2;
-            s.checkFlush(messageSize);
-            s << MessageTypes::NamedRegionStart << key;
-        }
+        MovableRegion(stream_t& s, const MessageKey key) : s(s) { s.regionStart(key); }
 
         MovableRegion(const MovableRegion&) = delete;
 
@@ -77,12 +52,7 @@ namespace lal
 
         ~MovableRegion() noexcept
         {
-            if (!moved)
-            {
-                static constexpr size_t messageSize = sizeof(MessageKey);
-                s.checkFlush(messageSize);
-                s << MessageTypes::RegionEnd;
-            }
+            if (!moved) s.regionEnd();
         }
 
         MovableRegion& operator=(const MovableRegion&) = delete;
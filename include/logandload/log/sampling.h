@@ -0,0 +1,129 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+
+////////////////////////////////////////////////////////////////
+// Current target includes.
+////////////////////////////////////////////////////////////////
+
+#include "logandload/log/format_type.h"
+
+namespace lal
+{
+    // clang-format off
+
+    /**
+     * \brief Format types with a sample member only log 1 in F::sample messages.
+     */
+    template<typename F>
+    concept has_sample = requires
+    {
+        { F::sample } -> std::convertible_to<uint32_t>;
+    };
+
+    /**
+     * \brief Format types with a rate member log at most F::rate messages per second, with bursts of up to F::burst
+     * messages (F::rate if there is no burst member).
+     */
+    template<typename F>
+    concept has_rate = requires
+    {
+        { F::rate } -> std::convertible_to<uint32_t>;
+    };
+
+    template<typename F>
+    concept has_burst = requires
+    {
+        { F::burst } -> std::convertible_to<uint32_t>;
+    };
+
+    template<typename F>
+    concept is_sampled_format = has_sample<F> || has_rate<F>;
+
+    // clang-format on
+
+    /**
+     * \brief Get the maximum number of messages a rate limited format type logs in a burst.
+     * \tparam F Format type.
+     * \return F::burst, or F::rate if there is no burst member.
+     */
+    template<has_rate F>
+    [[nodiscard]] consteval int64_t getBurst() noexcept
+    {
+        if constexpr (has_burst<F>)
+            return F::burst;
+        else
+            return F::rate;
+    }
+
+    /**
+     * \brief Minimum time between two records of the number of messages a format suppressed.
+     */
+    constexpr std::chrono::nanoseconds suppressedInterval = std::chrono::seconds(1);
+
+    /**
+     * \brief Sampling and rate limiting state of a single message type in a single stream.
+     */
+    struct Sampler
+    {
+        /**
+         * \brief Number of messages seen. Only used for sampling.
+         */
+        uint64_t count = 0;
+
+        /**
+         * \brief Token bucket, in nanoseconds of credit. Each message costs 1s / F::rate. Only used for rate limiting.
+         */
+        int64_t credit = 0;
+
+        /**
+         * \brief Time at which credit was last refilled, or 0 if the sampler was not used yet.
+         */
+        int64_t refilled = 0;
+
+        /**
+         * \brief Time at which the number of suppressed messages was last recorded.
+         */
+        int64_t recorded = 0;
+
+        /**
+         * \brief Number of messages suppressed since the last record.
+         */
+        uint64_t suppressed = 0;
+
+        /**
+         * \brief Key of the message type. Set when a message is suppressed.
+         */
+        MessageKey key;
+    };
+
+    /**
+     * \brief Number of sampler indices that were assigned.
+     */
+    constinit inline std::atomic_size_t samplerCount = 0;
+
+    /**
+     * \brief Get the next free sampler index.
+     * \return Index.
+     */
+    [[nodiscard]] inline size_t nextSamplerIndex() noexcept
+    {
+        return samplerCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Index of the sampler of a message type in the samplers of a stream. Assigned during static initialization,
+     * so that streams created afterwards can allocate the samplers of all message types up front.
+     * \tparam F Format type.
+     * \tparam Ts Dynamic parameter types.
+     */
+    template<typename F, typename... Ts>
+    inline const size_t samplerIndex = nextSamplerIndex();
+}  // namespace lal
@@ -4,11 +4,21 @@
 // Standard includes.
 ////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <limits>
 #include <memory>
+#include <ranges>
 #include <semaphore>
 #include <source_location>
+#include <span>
+#include <utility>
+#include <vector>
 
 ////////////////////////////////////////////////////////////////
 // Module includes.
@@ -21,16 +31,27 @@
 // Current target includes.
 ////////////////////////////////////////////////////////////////
 
+#include "logandload/log/buffering.h"
 #include "logandload/log/category.h"
+#include "logandload/log/fatal_signal.h"
+#include "logandload/log/format_registry.h"
+#include "logandload/log/log_file.h"
 #include "logandload/log/ordering.h"
+#include "logandload/log/overflow.h"
+#include "logandload/log/recovery.h"
 #include "logandload/log/region.h"
+#include "logandload/log/sampling.h"
+#include "logandload/log/timestamps.h"
 
 namespace lal
 {
-    template<is_category_filter C = CategoryFilterNone, Ordering Order = Ordering::Disabled>
+    template<is_category_filter C = CategoryFilterNone,
+             Ordering           Order = Ordering::Disabled,
+             Buffering          Buf   = Buffering::Double,
+             Timestamps         Time  = Timestamps::Disabled>
     class Log;
 
-    template<is_category_filter C, Ordering Order>
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
     class Stream
     {
     public:
@@ -38,9 +59,9 @@ namespace lal
         // Types.
         ////////////////////////////////////////////////////////////////
 
-        using log_t            = Log<C, Order>;
-        using region_t         = Region<Stream<C, Order>>;
-        using movable_region_t = MovableRegion<Stream<C, Order>>;
+        using log_t            = Log<C, Order, Buf, Time>;
+        using region_t         = Region<Stream<C, Order, Buf, Time>>;
+        using movable_region_t = MovableRegion<Stream<C, Order, Buf, Time>>;
 
         friend log_t;
         friend class region_t;
@@ -50,7 +71,11 @@ namespace lal
         // Constructors.
         ////////////////////////////////////////////////////////////////
 
-        Stream(log_t& logger, size_t streamIndex, size_t bufferSize);
+        Stream(log_t&          logger,
+               size_t          streamIndex,
+               size_t          bufferSize,
+               Overflow        overflowPolicy,
+               RecoveryStream* recoveryStream = nullptr);
 
         Stream() = delete;
 
@@ -69,7 +94,10 @@ namespace lal
         ////////////////////////////////////////////////////////////////
 
         /**
-         * \brief Write a message.
+         * \brief Write a message. Strings, string views and spans are written as variable-length parameters, preceded
+         * by their size. Their values are truncated if the message would not fit in half of the stream buffer. Messages
+         * below the minimum category of the log are skipped, as are messages suppressed by the sampling and rate
+         * limiting members of the format type (see sampling.h).
          * \tparam F Format type.
          * \tparam Ts Parameter types. Count must match number of dynamic parameters in format type message.
          * \param values Parameters.
@@ -102,7 +130,144 @@ namespace lal
         void sourceInfo(const std::source_location& loc);
 
     private:
-        void checkFlush(size_t messageSize);
+        /**
+         * \brief Size of the timestamp written with each message and region record.
+         */
+        static constexpr size_t timestampSize = Time == Timestamps::Disabled ? 0 : sizeof(uint64_t);
+
+        /**
+         * \brief Make room for a record. With the Block policy this always succeeds, waiting for the log if needed.
+         * Otherwise, pending records are written first and false is returned if the record must be dropped.
+         * \param messageSize Size of the record in bytes.
+         * \return True if the record can be written.
+         */
+        [[nodiscard]] bool checkFlush(size_t messageSize);
+
+        /**
+         * \brief Make room for a record and all pending records without waiting, dropping data according to the
+         * overflow policy. Writes pending records on success.
+         * \param messageSize Size of the record in bytes.
+         * \return True if the record can be written.
+         */
+        [[nodiscard]] bool makeRoom(size_t messageSize);
+
+        /**
+         * \brief Wait until the log has taken some data.
+         */
+        void waitForLog();
+
+        /**
+         * \brief Get the number of bytes that can be written without overwriting data the log has not taken yet.
+         * \return Number of bytes.
+         */
+        [[nodiscard]] size_t available();
+
+        /**
+         * \brief Get the size of the records that must be written before the next record.
+         * \return Size in bytes.
+         */
+        [[nodiscard]] size_t pendingSize() const noexcept;
+
+        /**
+         * \brief Write the dropped record, region ends of discarded data and deferred region starts.
+         */
+        void writePending();
+
+        /**
+         * \brief Drop all data that was not yet handed to the log.
+         */
+        void discard();
+
+        /**
+         * \brief Write a region start.
+         * \param key MessageTypes::AnonymousRegionStart or key of named region.
+         */
+        void regionStart(MessageKey key);
+
+        /**
+         * \brief Write a region end.
+         */
+        void regionEnd();
+
+        /**
+         * \brief Write pending records. Called by the log on destruction, when nothing is written anymore.
+         */
+        void recordDropped();
+
+        /**
+         * \brief Write the number of messages that sampled and rate limited message types suppressed since their last
+         * record, as far as it fits without waiting. Called before data is handed to the log and by the log on
+         * destruction, so that counts are not held back until the next message of the same type.
+         */
+        void recordSuppressed();
+
+        /**
+         * \brief Start writing to the next chunk of the circular buffer, overwriting its contents.
+         */
+        void nextChunk() noexcept;
+
+        /**
+         * \brief Append a consistent snapshot of the circular buffer to a log file image, as one block per chunk from
+         * oldest to newest. Can be called by any thread while the stream is being written. Chunks that are overwritten
+         * while they are copied are left out.
+         * \param out Log file image.
+         */
+        void snapshot(std::vector<uint8_t>& out) const;
+
+        /**
+         * \brief Write the circular buffer to a file, as one block per chunk from oldest to newest. Async-signal-safe,
+         * but does not detect chunks that are overwritten while they are written.
+         * \param fd File descriptor.
+         */
+        void dump(int fd) const noexcept;
+
+        /**
+         * \brief Decide whether a message of a sampled or rate limited format type is logged.
+         * \tparam F Format type.
+         * \param sampler Sampler of the message type.
+         * \param record Set to true if the number of suppressed messages must be recorded before the message.
+         * \return True if the message is logged.
+         */
+        template<typename F>
+        [[nodiscard]] static bool sample(Sampler& sampler, bool& record) noexcept;
+
+        /**
+         * \brief Get the sampler of a message type. Samplers are allocated when the stream is created, only message
+         * types that were registered after that (e.g. by a library that was loaded later) are allocated here.
+         * \param index Sampler index.
+         * \return Sampler.
+         */
+        [[nodiscard]] Sampler& getSampler(size_t index);
+
+        /**
+         * \brief Publish the current write position if the log requested it, so that the log can take all complete
+         * records without a flush. Only used if the log has a maximum flush latency.
+         */
+        void commit() noexcept;
+
+        /**
+         * \brief Get the data of a variable-length parameter.
+         * \tparam T Parameter type.
+         * \param value Parameter.
+         * \return Data.
+         */
+        template<typename T>
+        [[nodiscard]] static std::span<const std::byte> parameterData(const T& value) noexcept;
+
+        /**
+         * \brief Write a parameter to the stream buffer.
+         * \tparam T Parameter type.
+         * \param value Parameter.
+         * \param size Number of bytes to write of a variable-length parameter.
+         */
+        template<typename T>
+        void writeParameter(const T& value, uint32_t size);
+
+        /**
+         * \brief Write raw bytes to the stream buffer.
+         * \param data Data.
+         */
+        void write(std::span<const std::byte> data);
 
         /**
          * \brief Write a single value to the stream buffer.
@@ -118,6 +283,20 @@ namespace lal
          */
         void flush();
 
+        /**
+         * \brief Hand current buffer contents to the log. With double buffering, the back buffer must be free.
+         */
+        void handOver();
+
+        /**
+         * \brief Get the contents of the ring between two positions. Contents that wrap around the end of the ring are split in two parts.
+         * \param first Start position.
+         * \param last End position.
+         * \return Pair of spans. Second span is empty if contents do not wrap.
+         */
+        [[nodiscard]] std::pair<std::span<const uint8_t>, std::span<const uint8_t>> ringData(size_t first,
+                                                                                               size_t last) const noexcept;
+
         ////////////////////////////////////////////////////////////////
         // Member variables.
         ////////////////////////////////////////////////////////////////
@@ -132,6 +311,11 @@ namespace lal
          */
         size_t index;
 
+        /**
+         * \brief Sampling state of all sampled and rate limited message types, indexed by samplerIndex.
+         */
+        std::vector<Sampler> samplers;
+
         struct
         {
             /**
@@ -158,39 +342,290 @@ namespace lal
              * \brief Number of bytes in the back buffer that contain valid data. Always <= size.
              */
             size_t used = 0;
+
+            /**
+             * \brief Number of bytes at the start of the front buffer that the log already took. Only accessed by the
+             * log while it holds the flushed semaphore.
+             */
+            size_t taken = 0;
+
+            /**
+             * \brief Offset in the front buffer up to which records are complete. Only used if the log has a maximum
+             * flush latency.
+             */
+            alignas(64) std::atomic_size_t committed = 0;
         } buffer;
 
+        struct
+        {
+            /**
+             * \brief Size of the ring in bytes.
+             */
+            size_t size = 0;
+
+            /**
+             * \brief Ring buffer. Aligned to 64 bytes.
+             */
+            uint8_t* data = nullptr;
+
+            /**
+             * \brief Current offset in the ring.
+             */
+            size_t offset = 0;
+
+            /**
+             * \brief Total number of bytes written. Only accessed by the writing thread.
+             */
+            size_t head = 0;
+
+            /**
+             * \brief Last known value of consumed. Only accessed by the writing thread.
+             */
+            size_t tail = 0;
+
+            /**
+             * \brief Value of head at the last flush. Only accessed by the writing thread.
+             */
+            size_t published = 0;
+
+            /**
+             * \brief Total number of bytes taken by the log. Only accessed by the log's processor thread.
+             */
+            size_t taken = 0;
+
+            /**
+             * \brief Total number of bytes handed to the log.
+             */
+            alignas(64) std::atomic_size_t committed = 0;
+
+            /**
+             * \brief Total number of bytes the log is done with.
+             */
+            alignas(64) std::atomic_size_t consumed = 0;
+
+            /**
+             * \brief Set while this stream is in the log's flush queue.
+             */
+            std::atomic_bool queued = false;
+        } ring;
+
+        struct
+        {
+            /**
+             * \brief Region of this stream in the recovery file of the log, which holds the stream buffers. Null if the
+             * log is not recoverable.
+             */
+            RecoveryStream* stream = nullptr;
+
+            /**
+             * \brief Index of the front buffer in the region. Only used with Buffering::Double.
+             */
+            size_t front = 0;
+        } recovery;
+
+        /**
+         * \brief Number of chunks in the circular buffer.
+         */
+        static constexpr size_t chunkCount = 8;
+
+        struct Chunk
+        {
+            /**
+             * \brief Incremented each time the chunk is reused. 0 if the chunk was never used.
+             */
+            std::atomic_uint64_t generation = 0;
+
+            /**
+             * \brief Number of bytes in the chunk that contain complete records.
+             */
+            std::atomic_size_t used = 0;
+        };
+
+        struct
+        {
+            /**
+             * \brief Size of each chunk in bytes.
+             */
+            size_t size = 0;
+
+            /**
+             * \brief Chunk data. Aligned to 64 bytes.
+             */
+            uint8_t* data = nullptr;
+
+            /**
+             * \brief State of each chunk.
+             */
+            std::array<Chunk, chunkCount> chunks;
+
+            /**
+             * \brief Index of the chunk that is being written.
+             */
+            size_t current = 0;
+
+            /**
+             * \brief Current offset in the chunk that is being written.
+             */
+            size_t offset = 0;
+
+            /**
+             * \brief Generation of the chunk that is being written.
+             */
+            uint64_t generation = 0;
+        } circular;
+
         /**
          * \brief Semaphore for waiting and signaling flush state.
          */
         std::binary_semaphore flushed;
+
+        /**
+         * \brief Next stream in the log's flush queue. Owned by the log while this stream is queued.
+         */
+        Stream* next = nullptr;
+
+        /**
+         * \brief If true, the write position is published when the log requests it. See LogSettings::maxFlushLatency.
+         */
+        bool committing = false;
+
+        /**
+         * \brief Set by the log's processor thread at each tick of the flush latency timer to request that the next
+         * record publishes the write position. Only used if committing.
+         */
+        std::atomic_bool publish = true;
+
+        struct
+        {
+            /**
+             * \brief Overflow policy.
+             */
+            Overflow policy = Overflow::Block;
+
+            /**
+             * \brief Open regions, innermost last. Holds MessageTypes::AnonymousRegionStart or the key of a named
+             * region. Not used with the Block policy.
+             */
+            std::vector<MessageKey> regions;
+
+            /**
+             * \brief Number of open regions (counted from the outermost) whose start was written. Starts of the
+             * others were deferred or discarded and are written before the next record.
+             */
+            size_t written = 0;
+
+            /**
+             * \brief Number of open regions (counted from the outermost) whose start was handed to the log.
+             */
+            size_t handed = 0;
+
+            /**
+             * \brief Number of region ends in data that was not yet handed to the log, which close regions whose
+             * start was handed to the log. These must be written again if that data is discarded.
+             */
+            size_t ends = 0;
+
+            /**
+             * \brief Number of region ends that must be written before the next record, which close regions whose
+             * start was handed to the log. Discarding data never removes these.
+             */
+            size_t pendingEnds = 0;
+
+            /**
+             * \brief Number of region ends that must be written before the next record, which close regions whose
+             * start was not handed to the log yet. Discarding data removes these together with the starts.
+             */
+            size_t pendingUnhandedEnds = 0;
+
+            /**
+             * \brief Number and size of dropped messages that were not yet recorded.
+             */
+            uint64_t messages = 0, bytes = 0;
+
+            /**
+             * \brief Number and size of dropped messages recorded in data that was not yet handed to the log.
+             */
+            uint64_t recordedMessages = 0, recordedBytes = 0;
+
+            /**
+             * \brief Number and size of messages in data that was not yet handed to the log.
+             */
+            uint64_t unhandedMessages = 0, unhandedBytes = 0;
+        } overflow;
     };
 
     ////////////////////////////////////////////////////////////////
     // Constructors.
     ////////////////////////////////////////////////////////////////
 
-    template<is_category_filter C, Ordering Order>
-    Stream<C, Order>::Stream(log_t& logger, const size_t streamIndex, const size_t bufferSize) :
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    Stream<C, Order, Buf, Time>::Stream(log_t&                logger,
+                                  const size_t          streamIndex,
+                                  const size_t          bufferSize,
+                                  const Overflow        overflowPolicy,
+                                  RecoveryStream* const recoveryStream) :
         log(&logger), index(streamIndex), flushed(1)
     {
         assert(bufferSize > 0);
-        buffer.size = bufferSize;
+        overflow.policy = overflowPolicy;
+        committing      = logger.log.settings.maxFlushLatency.count() > 0;
+
+        recovery.stream = recoveryStream;
+
+        // Allocate the samplers of all sampled and rate limited message types, so that logging does not allocate.
+        samplers.resize(samplerCount.load(std::memory_order_relaxed));
+
+        if constexpr (Buf == Buffering::Double)
+        {
+            buffer.size = bufferSize;
 
-        // Create stream buffers aligned to 64 bytes.
-        buffer.front = static_cast<uint8_t*>(common::aligned_alloc(64, buffer.size));
-        buffer.back  = static_cast<uint8_t*>(common::aligned_alloc(64, buffer.size));
+            // Create stream buffers aligned to 64 bytes, or use the ones in the recovery file.
+            if (recovery.stream)
+            {
+                buffer.front = recovery.stream->data(0);
+                buffer.back  = recovery.stream->data(1);
+            }
+            else
+            {
+                buffer.front = static_cast<uint8_t*>(common::aligned_alloc(64, buffer.size));
+                buffer.back  = static_cast<uint8_t*>(common::aligned_alloc(64, buffer.size));
+            }
+        }
+        else if constexpr (Buf == Buffering::Circular)
+        {
+            circular.size = bufferSize / chunkCount;
+            assert(circular.size > 0);
+
+            // Create chunks aligned to 64 bytes and start writing to the first one.
+            circular.data = static_cast<uint8_t*>(common::aligned_alloc(64, circular.size * chunkCount));
+            circular.chunks.front().generation.store(++circular.generation, std::memory_order_relaxed);
+        }
+        else
+        {
+            ring.size = bufferSize;
+
+            // Create ring buffer aligned to 64 bytes, or use the one in the recovery file.
+            ring.data = recovery.stream ? recovery.stream->data(0)
+                                        : static_cast<uint8_t*>(common::aligned_alloc(64, ring.size));
+        }
     }
 
-    template<is_category_filter C, Ordering Order>
-    Stream<C, Order>::~Stream() noexcept
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    Stream<C, Order, Buf, Time>::~Stream() noexcept
     {
+        // Buffers in the recovery file are unmapped by the log.
+        if (recovery.stream) return;
+
 #ifdef WIN32
         _aligned_free(buffer.front);
         _aligned_free(buffer.back);
+        _aligned_free(ring.data);
+        _aligned_free(circular.data);
 #else
         std::free(buffer.front);
         std::free(buffer.back);
+        std::free(ring.data);
+        std::free(circular.data);
 #endif
     }
 
@@ -198,23 +633,86 @@ namespace lal
     // Logging.
     ////////////////////////////////////////////////////////////////
 
-    template<is_category_filter C, Ordering Order>
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
     template<typename F, std::copyable... Ts>
-    requires(is_format_type<F, Ts...>) void Stream<C, Order>::message(const Ts&... values)
+    requires(is_format_type<F, Ts...>) void Stream<C, Order, Buf, Time>::message(const Ts&... values)
     {
-        // Size of the message in bytes = sizeof(key) + sizeof(parameters...) + sizeof(index).
-        static constexpr size_t messageSize =
-          (sizeof(MessageKey) + ... + sizeof(Ts)) +
-          (Order == Ordering::Enabled ? sizeof(typename decltype(log->log.messageIndex)::value_type) : 0);
+        // Size of the message in bytes = sizeof(key) + sizeof(parameters...) + sizeof(index) + sizeof(timestamp).
+        // Variable-length parameters only count their size prefix here.
+        static constexpr size_t fixedSize =
+          (sizeof(MessageKey) + ... +
+           (is_variable_parameter_v<parameter_t<Ts>> ? sizeof(uint32_t) : sizeof(Ts))) +
+          (Order == Ordering::Enabled ? sizeof(typename decltype(log->log.messageIndex)::value_type) : 0) +
+          timestampSize;
 
-        // Log message if category is valid.
+        // Log message if category is valid, first at compile time and then at run time.
         if constexpr (log_t::category_t::template message<F>())
         {
-            // Calculate key and register format.
+            if (F::category < log->log.minimumCategory.load(std::memory_order_relaxed)) return;
+
+            // Calculate key. Referencing the registrar registers the format during static initialization.
             static constexpr auto key = hashMessage<F, Ts...>();
-            log->template registerFormat<F, Ts...>(key);
+            static_cast<void>(&formatRegistrar<log_t, F, Ts...>);
+
+            // Skip message if its format type suppresses it. The number of suppressed messages is recorded before a
+            // later message of the same type, or before the stream hands its data to the log.
+            [[maybe_unused]] Sampler* sampler = nullptr;
+            bool                      record  = false;
+            if constexpr (is_sampled_format<F>)
+            {
+                sampler = &getSampler(samplerIndex<F, Ts...>);
+                if (!sample<F>(*sampler, record))
+                {
+                    sampler->key = key;
+                    return;
+                }
+            }
+
+            // Determine the size of variable-length parameters, truncating them to whole elements once the message
+            // would no longer fit in half of the stream buffer.
+            std::array<uint32_t, sizeof...(Ts)> sizes{};
+            size_t                              messageSize = fixedSize;
+            if constexpr ((is_variable_parameter_v<parameter_t<Ts>> || ...))
+            {
+                const auto maxSize =
+                  (Buf == Buffering::Double ? buffer.size : Buf == Buffering::Ring ? ring.size : circular.size) / 2;
+                assert(fixedSize <= maxSize);
+                size_t i = 0;
+                (
+                  [&] {
+                      if constexpr (is_variable_parameter_v<parameter_t<Ts>>)
+                      {
+                          const auto data    = parameterData(values);
+                          const auto element = sizeof(*std::data(values));
+                          const auto size = std::min(data.size(), (maxSize - messageSize) / element * element);
+                          sizes[i]        = static_cast<uint32_t>(
+                            std::min<size_t>(size, std::numeric_limits<uint32_t>::max() / element * element));
+                          messageSize += sizes[i];
+                      }
+                      i++;
+                  }(),
+                  ...);
+            }
 
-            checkFlush(messageSize);
+            static constexpr size_t suppressedSize = sizeof(MessageKey) * 2 + sizeof(uint64_t);
+            if (!checkFlush(messageSize + (record ? suppressedSize : 0)))
+            {
+                overflow.messages++;
+                overflow.bytes += messageSize;
+                return;
+            }
+            overflow.unhandedMessages++;
+            overflow.unhandedBytes += messageSize;
+
+            // Record suppressed messages.
+            if constexpr (is_sampled_format<F>)
+            {
+                if (record)
+                {
+                    *this << MessageTypes::Suppressed << sampler->suppressed << key;
+                    sampler->suppressed = 0;
+                }
+            }
 
             // Write message key.
             *this << key;
@@ -222,14 +720,20 @@ namespace lal
             // If ordering is enabled, write unique message index.
             if constexpr (Order == Ordering::Enabled) *this << log->log.messageIndex++;
 
+            // If timestamps are enabled, write current time.
+            if constexpr (Time != Timestamps::Disabled) *this << readTimestamp<Time>();
+
             // Write values.
-            (*this << ... << values);
+            [[maybe_unused]] size_t i = 0;
+            (writeParameter(values, sizes[i++]), ...);
+
+            commit();
         }
     }
 
-    template<is_category_filter C, Ordering Order>
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
     template<typename F>
-    auto Stream<C, Order>::region()
+    auto Stream<C, Order, Buf, Time>::region()
     {
         if constexpr (C::template region())
         {
@@ -238,7 +742,7 @@ namespace lal
             else if constexpr (is_format_type<F>)
             {
                 static constexpr auto key = hashMessage<F>();
-                log->template registerFormat<F>(key);
+                static_cast<void>(&formatRegistrar<log_t, F>);
                 return region_t(*this, key);
             }
             else
@@ -248,9 +752,9 @@ namespace lal
             return DisabledRegion();
     }
 
-    template<is_category_filter C, Ordering Order>
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
     template<typename F>
-    auto Stream<C, Order>::movableRegion()
+    auto Stream<C, Order, Buf, Time>::movableRegion()
     {
         if constexpr (C::template region())
         {
@@ -259,7 +763,7 @@ namespace lal
             else if constexpr (is_format_type<F>)
             {
                 static constexpr auto key = hashMessage<F>();
-                log->template registerFormat<F>(key);
+                static_cast<void>(&formatRegistrar<log_t, F>);
                 return movable_region_t(*this, key);
             }
             else
@@ -269,55 +773,638 @@ namespace lal
             return DisabledRegion();
     }
 
-    template<is_category_filter C, Ordering Order>
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
     template<uint32_t K>
-    void Stream<C, Order>::sourceInfo(const std::source_location& loc)
+    void Stream<C, Order, Buf, Time>::sourceInfo(const std::source_location& loc)
     {
         static constexpr auto K2 = MessageKey{K};
         if constexpr (C::template source())
         {
-            static constexpr size_t messageSize = sizeof(MessageKey);
-            checkFlush(messageSize);
+            // Source information is read as a message without parameters, so it has the same index and timestamp.
+            static constexpr size_t messageSize =
+              sizeof(MessageKey) +
+              (Order == Ordering::Enabled ? sizeof(typename decltype(log->log.messageIndex)::value_type) : 0) +
+              timestampSize;
+            static const auto registered = log->template registerSourceLocation<K>(loc);
+            static_cast<void>(registered);
+
+            if (!checkFlush(messageSize))
+            {
+                overflow.messages++;
+                overflow.bytes += messageSize;
+                return;
+            }
+            overflow.unhandedMessages++;
+            overflow.unhandedBytes += messageSize;
 
-            log->registerSourceLocation<K2>(loc);
             *this << K2;
+            if constexpr (Order == Ordering::Enabled) *this << log->log.messageIndex++;
+            if constexpr (Time != Timestamps::Disabled) *this << readTimestamp<Time>();
+            commit();
+        }
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Stream<C, Order, Buf, Time>::regionStart(const MessageKey key)
+    {
+        const size_t messageSize =
+          sizeof(MessageKey) * (key == MessageTypes::AnonymousRegionStart ? 1 : 2) + timestampSize;
+
+        if (overflow.policy == Overflow::Block)
+        {
+            [[maybe_unused]] const auto ok = checkFlush(messageSize);
+            if (key == MessageTypes::AnonymousRegionStart)
+                *this << MessageTypes::AnonymousRegionStart;
+            else
+                *this << MessageTypes::NamedRegionStart << key;
+            if constexpr (Time != Timestamps::Disabled) *this << readTimestamp<Time>();
+            commit();
+            return;
+        }
+
+        // Start is written as a pending record. If there is no room, it is deferred instead of dropped, so that the
+        // messages in this region are not attributed to its parent once they can be written again.
+        overflow.regions.push_back(key);
+        if (makeRoom(0)) commit();
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Stream<C, Order, Buf, Time>::regionEnd()
+    {
+        static constexpr size_t messageSize = sizeof(MessageKey) + timestampSize;
+
+        if (overflow.policy == Overflow::Block)
+        {
+            [[maybe_unused]] const auto ok = checkFlush(messageSize);
+            *this << MessageTypes::RegionEnd;
+            if constexpr (Time != Timestamps::Disabled) *this << readTimestamp<Time>();
+            commit();
+            return;
+        }
+
+        // Start was never written, so neither is the end.
+        if (overflow.regions.size() > overflow.written)
+        {
+            overflow.regions.pop_back();
+            return;
+        }
+
+        overflow.regions.pop_back();
+        overflow.written--;
+        if (overflow.handed > overflow.regions.size())
+        {
+            overflow.handed--;
+            overflow.pendingEnds++;
+        }
+        else
+            overflow.pendingUnhandedEnds++;
+
+        // End is written as a pending record. Room for it was reserved when the start was written, so this only
+        // waits if other pending records do not fit.
+        while (!makeRoom(0)) waitForLog();
+        commit();
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Stream<C, Order, Buf, Time>::recordDropped()
+    {
+        // Best effort. The log does not take any more data, so there is nothing to wait for.
+        if (overflow.policy != Overflow::Block && pendingSize() > 0)
+        {
+            [[maybe_unused]] const auto ok = makeRoom(0);
+        }
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Stream<C, Order, Buf, Time>::recordSuppressed()
+    {
+        static constexpr size_t suppressedSize = sizeof(MessageKey) * 2 + sizeof(uint64_t);
+        static constexpr size_t droppedSize    = sizeof(MessageKey) + sizeof(uint64_t) * 2;
+
+        for (auto& sampler : samplers)
+        {
+            if (sampler.suppressed == 0) continue;
+
+            // Only use room that is not reserved for pending records and the ends of open regions.
+            const auto reserved =
+              overflow.policy == Overflow::Block
+                ? 0
+                : pendingSize() + overflow.regions.size() * (sizeof(MessageKey) + timestampSize) + droppedSize;
+            if (available() < reserved + suppressedSize) return;
+
+            *this << MessageTypes::Suppressed << sampler.suppressed << sampler.key;
+            sampler.suppressed = 0;
+        }
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    bool Stream<C, Order, Buf, Time>::checkFlush(const size_t messageSize)
+    {
+        // Records never cross chunks, so that every chunk can be read on its own.
+        if constexpr (Buf == Buffering::Circular)
+        {
+            assert(messageSize <= circular.size);
+            if (messageSize + circular.offset > circular.size) nextChunk();
+            return true;
+        }
+
+        if (overflow.policy != Overflow::Block) return makeRoom(messageSize);
+
+        if constexpr (Buf == Buffering::Double)
+        {
+            assert(messageSize <= buffer.size);
+
+            // Buffer would overflow when writing this message.
+            if (messageSize + buffer.offset > buffer.size) flush();
+        }
+        else
+        {
+            assert(messageSize <= ring.size);
+
+            // Hand data to the log once half of the ring is filled.
+            if (ring.head - ring.published >= ring.size / 2) flush();
+
+            // Ring would overflow when writing this message. Wait for the log to consume enough data.
+            if (ring.head + messageSize - ring.tail > ring.size)
+            {
+                if (ring.head != ring.published) flush();
+
+                for (ring.tail = ring.consumed.load(); ring.head + messageSize - ring.tail > ring.size;
+                     ring.tail = ring.consumed.load())
+                    ring.consumed.wait(ring.tail);
+            }
         }
+
+        return true;
     }
 
-    template<is_category_filter C, Ordering Order>
-    void Stream<C, Order>::checkFlush(const size_t messageSize)
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    bool Stream<C, Order, Buf, Time>::makeRoom(const size_t messageSize)
     {
-        assert(messageSize <= buffer.size);
+        // Besides the record itself, keep room for the ends of all open regions and one dropped record, which must
+        // be written later even if no more room is made.
+        static constexpr size_t droppedSize = sizeof(MessageKey) + sizeof(uint64_t) * 2;
+        const auto              needed      = [&] {
+            return pendingSize() + messageSize + overflow.regions.size() * (sizeof(MessageKey) + timestampSize) +
+                   droppedSize;
+        };
+
+        if constexpr (Buf == Buffering::Ring)
+        {
+            // Hand data to the log once half of the ring is filled.
+            if (ring.head - ring.published >= ring.size / 2) flush();
+        }
 
-        // Buffer would overflow when writing this message.
-        if (messageSize + buffer.offset > buffer.size) flush();
+        if (needed() > available())
+        {
+            if constexpr (Buf == Buffering::Double)
+            {
+                if (flushed.try_acquire())
+                    handOver();
+                else if (overflow.policy == Overflow::DropBuffer && buffer.offset > 0)
+                    discard();
+            }
+            else
+            {
+                if (overflow.policy == Overflow::DropBuffer && ring.head != ring.published)
+                    discard();
+                else if (ring.head != ring.published)
+                    flush();
+            }
+
+            if (needed() > available()) return false;
+        }
+
+        writePending();
+        return true;
     }
 
-    template<is_category_filter C, Ordering Order>
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Stream<C, Order, Buf, Time>::waitForLog()
+    {
+        if constexpr (Buf == Buffering::Double)
+        {
+            flushed.acquire();
+            flushed.release();
+        }
+        else
+        {
+            if (ring.head != ring.published) flush();
+            ring.consumed.wait(ring.tail);
+        }
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    size_t Stream<C, Order, Buf, Time>::available()
+    {
+        if constexpr (Buf == Buffering::Double)
+            return buffer.size - buffer.offset;
+        else
+        {
+            ring.tail = ring.consumed.load();
+            return ring.size - (ring.head - ring.tail);
+        }
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    size_t Stream<C, Order, Buf, Time>::pendingSize() const noexcept
+    {
+        size_t size = 0;
+        if (overflow.messages > 0) size += sizeof(MessageKey) + sizeof(uint64_t) * 2;
+        size += (overflow.pendingEnds + overflow.pendingUnhandedEnds) * (sizeof(MessageKey) + timestampSize);
+        for (size_t i = overflow.written; i < overflow.regions.size(); i++)
+            size += sizeof(MessageKey) * (overflow.regions[i] == MessageTypes::AnonymousRegionStart ? 1 : 2) +
+                    timestampSize;
+        return size;
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Stream<C, Order, Buf, Time>::writePending()
+    {
+        if (overflow.messages > 0)
+        {
+            *this << MessageTypes::Dropped << overflow.messages << overflow.bytes;
+            overflow.recordedMessages += overflow.messages;
+            overflow.recordedBytes += overflow.bytes;
+            overflow.messages = 0;
+            overflow.bytes    = 0;
+        }
+
+        // Deferred region records carry the time at which they are written, not the time of the original call.
+        [[maybe_unused]] const uint64_t timestamp = Time == Timestamps::Disabled ? 0 : readTimestamp<Time>();
+
+        for (; overflow.pendingEnds > 0; overflow.pendingEnds--)
+        {
+            *this << MessageTypes::RegionEnd;
+            if constexpr (Time != Timestamps::Disabled) *this << timestamp;
+            overflow.ends++;
+        }
+
+        for (; overflow.pendingUnhandedEnds > 0; overflow.pendingUnhandedEnds--)
+        {
+            *this << MessageTypes::RegionEnd;
+            if constexpr (Time != Timestamps::Disabled) *this << timestamp;
+        }
+
+        for (; overflow.written < overflow.regions.size(); overflow.written++)
+        {
+            if (const auto key = overflow.regions[overflow.written]; key == MessageTypes::AnonymousRegionStart)
+                *this << MessageTypes::AnonymousRegionStart;
+            else
+                *this << MessageTypes::NamedRegionStart << key;
+            if constexpr (Time != Timestamps::Disabled) *this << timestamp;
+        }
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Stream<C, Order, Buf, Time>::discard()
+    {
+        // Everything since the last hand over is dropped, including earlier dropped records.
+        overflow.messages += overflow.unhandedMessages + overflow.recordedMessages;
+        overflow.bytes += overflow.unhandedBytes + overflow.recordedBytes;
+        overflow.unhandedMessages = overflow.unhandedBytes = 0;
+        overflow.recordedMessages = overflow.recordedBytes = 0;
+
+        // Region records must survive, so that the structure of the stream stays intact. Ends of regions the log
+        // already has are written again, starts of regions that are still open are written again.
+        overflow.pendingEnds += overflow.ends;
+        overflow.ends                = 0;
+        overflow.pendingUnhandedEnds = 0;
+        overflow.written             = overflow.handed;
+
+        if constexpr (Buf == Buffering::Double)
+            buffer.offset = 0;
+        else
+        {
+            ring.head   = ring.published;
+            ring.offset = ring.head % ring.size;
+        }
+
+        // Discarded records must not be recovered.
+        if (recovery.stream)
+        {
+            if constexpr (Buf == Buffering::Double)
+                recovery.stream->used[recovery.front].store(0, std::memory_order_release);
+            else
+                recovery.stream->used[0].store(ring.head, std::memory_order_release);
+        }
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Stream<C, Order, Buf, Time>::nextChunk() noexcept
+    {
+        circular.current = (circular.current + 1) % chunkCount;
+        circular.offset  = 0;
+
+        // Readers that see any of the new data also see the new generation, so that they can detect the overwrite.
+        auto& chunk = circular.chunks[circular.current];
+        chunk.generation.store(++circular.generation, std::memory_order_relaxed);
+        chunk.used.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Stream<C, Order, Buf, Time>::snapshot(std::vector<uint8_t>& out) const
+    {
+        // Order chunks from oldest to newest.
+        std::array<std::pair<uint64_t, size_t>, chunkCount> order;
+        for (size_t i = 0; i < chunkCount; i++)
+            order[i] = {circular.chunks[i].generation.load(std::memory_order_relaxed), i};
+        std::ranges::sort(order);
+
+        for (const auto i : order | std::views::values)
+        {
+            const auto& chunk      = circular.chunks[i];
+            const auto  generation = chunk.generation.load(std::memory_order_acquire);
+            const auto  used       = chunk.used.load(std::memory_order_acquire);
+            if (generation == 0 || used == 0) continue;
+
+            // Copy block header and data.
+            const auto offset = out.size();
+            out.resize(offset + maxBlockHeaderSize + used);
+            const auto headerSize = encodeBlockHeader(index, used, out.data() + offset);
+            std::memcpy(out.data() + offset + headerSize, circular.data + i * circular.size, used);
+            out.resize(offset + headerSize + used);
+
+            // Discard the copy if the chunk was reused in the meantime.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (chunk.generation.load(std::memory_order_relaxed) != generation) out.resize(offset);
+        }
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Stream<C, Order, Buf, Time>::dump(const int fd) const noexcept
+    {
+        // Order chunks from oldest to newest.
+        std::array<std::pair<uint64_t, size_t>, chunkCount> order;
+        for (size_t i = 0; i < chunkCount; i++)
+            order[i] = {circular.chunks[i].generation.load(std::memory_order_relaxed), i};
+        std::ranges::sort(order);
+
+        for (const auto& [generation, i] : order)
+        {
+            const auto used = circular.chunks[i].used.load(std::memory_order_acquire);
+            if (generation == 0 || used == 0) continue;
+
+            std::array<uint8_t, maxBlockHeaderSize> header;
+            writeFileSignalSafe(fd, header.data(), encodeBlockHeader(index, used, header.data()));
+            writeFileSignalSafe(fd, circular.data + i * circular.size, used);
+        }
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    template<typename F>
+    bool Stream<C, Order, Buf, Time>::sample(Sampler& sampler, bool& record) noexcept
+    {
+        int64_t    now  = 0;
+        const auto time = [&now] {
+            if (now == 0)
+                now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch())
+                        .count();
+            return now;
+        };
+
+        // Log 1 in F::sample messages.
+        bool logged = true;
+        if constexpr (has_sample<F>)
+        {
+            static_assert(F::sample > 0);
+            logged = sampler.count++ % F::sample == 0;
+        }
+
+        // Take one message worth of credit from the token bucket, which refills at F::rate messages per second.
+        if constexpr (has_rate<F>)
+        {
+            static_assert(F::rate > 0);
+            static constexpr int64_t cost = std::chrono::nanoseconds(std::chrono::seconds(1)).count() / F::rate;
+            static constexpr int64_t capacity = cost * getBurst<F>();
+
+            if (logged)
+            {
+                if (sampler.refilled == 0)
+                    sampler.credit = capacity;
+                else
+                    sampler.credit = std::min(capacity, sampler.credit + (time() - sampler.refilled));
+                sampler.refilled = time();
+
+                if (sampler.credit >= cost)
+                    sampler.credit -= cost;
+                else
+                    logged = false;
+            }
+        }
+
+        if (!logged)
+        {
+            sampler.suppressed++;
+            return false;
+        }
+
+        // Record the number of suppressed messages at most once per interval.
+        if (sampler.suppressed > 0 && time() - sampler.recorded >= suppressedInterval.count())
+        {
+            sampler.recorded = time();
+            record           = true;
+        }
+
+        return true;
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    Sampler& Stream<C, Order, Buf, Time>::getSampler(const size_t index)
+    {
+        if (index >= samplers.size()) samplers.resize(index + 1);
+        return samplers[index];
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Stream<C, Order, Buf, Time>::commit() noexcept
+    {
+        // A flight recorder can be dumped at any time.
+        if constexpr (Buf == Buffering::Circular)
+        {
+            circular.chunks[circular.current].used.store(circular.offset, std::memory_order_release);
+            return;
+        }
+
+        // Complete records survive a crash of the process.
+        if (recovery.stream)
+        {
+            if constexpr (Buf == Buffering::Double)
+                recovery.stream->used[recovery.front].store(buffer.offset, std::memory_order_release);
+            else
+                recovery.stream->used[0].store(ring.head, std::memory_order_release);
+        }
+
+        // Publishing after each record would write a cache line that is shared with the processor thread. Instead,
+        // only the first record after a request publishes. Checking for a request does not write.
+        if (!committing || !publish.load(std::memory_order_relaxed)) return;
+        publish.store(false, std::memory_order_relaxed);
+
+        if constexpr (Buf == Buffering::Double)
+            buffer.committed.store(buffer.offset, std::memory_order_release);
+        else
+            ring.committed.store(ring.head, std::memory_order_release);
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
     template<typename T>
-    Stream<C, Order>& Stream<C, Order>::operator<<(const T& value)
+    std::span<const std::byte> Stream<C, Order, Buf, Time>::parameterData(const T& value) noexcept
     {
-        assert(sizeof(T) <= buffer.size && sizeof(T) + buffer.offset <= buffer.size);
+        return std::as_bytes(std::span(std::data(value), std::size(value)));
+    }
 
-        // Write value to buffer.
-        reinterpret_cast<T&>(buffer.front[buffer.offset]) = value;
-        buffer.offset += sizeof(T);
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    template<typename T>
+    void Stream<C, Order, Buf, Time>::writeParameter(const T& value, const uint32_t size)
+    {
+        if constexpr (is_variable_parameter_v<parameter_t<T>>)
+        {
+            *this << size;
+            write(parameterData(value).first(size));
+        }
+        else
+            *this << value;
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Stream<C, Order, Buf, Time>::write(const std::span<const std::byte> data)
+    {
+        if (data.empty()) return;
+
+        if constexpr (Buf == Buffering::Double)
+        {
+            assert(data.size() + buffer.offset <= buffer.size);
+
+            std::memcpy(buffer.front + buffer.offset, data.data(), data.size());
+            buffer.offset += data.size();
+        }
+        else if constexpr (Buf == Buffering::Circular)
+        {
+            assert(data.size() + circular.offset <= circular.size);
+
+            std::memcpy(circular.data + circular.current * circular.size + circular.offset, data.data(), data.size());
+            circular.offset += data.size();
+        }
+        else
+        {
+            assert(ring.head + data.size() - ring.tail <= ring.size);
+
+            // Copy data to ring, splitting it if it wraps around the end.
+            const auto first = std::min(data.size(), ring.size - ring.offset);
+            std::memcpy(ring.data + ring.offset, data.data(), first);
+            std::memcpy(ring.data, data.data() + first, data.size() - first);
+            ring.offset = (ring.offset + data.size()) % ring.size;
+            ring.head += data.size();
+        }
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    template<typename T>
+    Stream<C, Order, Buf, Time>& Stream<C, Order, Buf, Time>::operator<<(const T& value)
+    {
+        if constexpr (Buf == Buffering::Double)
+        {
+            assert(sizeof(T) <= buffer.size && sizeof(T) + buffer.offset <= buffer.size);
+
+            // Write value to buffer.
+            reinterpret_cast<T&>(buffer.front[buffer.offset]) = value;
+            buffer.offset += sizeof(T);
+        }
+        else if constexpr (Buf == Buffering::Circular)
+        {
+            assert(sizeof(T) + circular.offset <= circular.size);
+
+            std::memcpy(circular.data + circular.current * circular.size + circular.offset, &value, sizeof(T));
+            circular.offset += sizeof(T);
+        }
+        else
+        {
+            assert(ring.head + sizeof(T) - ring.tail <= ring.size);
+
+            // Write value to ring, splitting it if it wraps around the end.
+            if (const auto remaining = ring.size - ring.offset; sizeof(T) < remaining)
+            {
+                reinterpret_cast<T&>(ring.data[ring.offset]) = value;
+                ring.offset += sizeof(T);
+            }
+            else
+            {
+                std::memcpy(ring.data + ring.offset, &value, remaining);
+                std::memcpy(ring.data, reinterpret_cast<const uint8_t*>(&value) + remaining, sizeof(T) - remaining);
+                ring.offset = sizeof(T) - remaining;
+            }
+            ring.head += sizeof(T);
+        }
 
         return *this;
     }
 
-    template<is_category_filter C, Ordering Order>
-    void Stream<C, Order>::flush()
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Stream<C, Order, Buf, Time>::flush()
     {
+        recordSuppressed();
+
         // Wait to ensure back buffer has been flushed to log's front buffer.
-        flushed.acquire();
+        if constexpr (Buf == Buffering::Double) flushed.acquire();
+
+        handOver();
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    void Stream<C, Order, Buf, Time>::handOver()
+    {
+        // Data can no longer be discarded.
+        overflow.handed = overflow.written;
+        overflow.ends   = 0;
+        overflow.pendingEnds += overflow.pendingUnhandedEnds;
+        overflow.pendingUnhandedEnds = 0;
+        overflow.recordedMessages = overflow.recordedBytes = 0;
+        overflow.unhandedMessages = overflow.unhandedBytes = 0;
+
+        if constexpr (Buf == Buffering::Double)
+        {
+            // Swap buffers.
+            std::swap(buffer.front, buffer.back);
+            buffer.used   = buffer.offset;
+            buffer.offset = 0;
+            if (committing) buffer.committed.store(0, std::memory_order_relaxed);
+
+            // The new front buffer continues where the back buffer ends. It is emptied before it is moved, so that
+            // recovery never sees its old contents at the new position.
+            if (recovery.stream)
+            {
+                auto&      r     = *recovery.stream;
+                const auto start = r.start[recovery.front].load(std::memory_order_relaxed) + buffer.used;
+                r.used[recovery.front].store(buffer.used, std::memory_order_release);
+                recovery.front ^= 1;
+                r.used[recovery.front].store(0, std::memory_order_release);
+                r.start[recovery.front].store(start, std::memory_order_release);
+            }
+
+            // Flush buffer.
+            log->flush(*this);
+        }
+        else
+        {
+            // Publish written data. Stream only needs to be queued if the log has not yet picked it up since the last flush.
+            ring.published = ring.head;
+            ring.committed = ring.head;
+            if (!ring.queued.exchange(true)) log->flush(*this);
+        }
+    }
+
+    template<is_category_filter C, Ordering Order, Buffering Buf, Timestamps Time>
+    auto Stream<C, Order, Buf, Time>::ringData(const size_t first, const size_t last) const noexcept
+      -> std::pair<std::span<const uint8_t>, std::span<const uint8_t>>
+    {
+        assert(first <= last && last - first <= ring.size);
 
-        // Swap buffers.
-        std::swap(buffer.front, buffer.back);
-        buffer.used   = buffer.offset;
-        buffer.offset = 0;
+        const auto offset = first % ring.size;
+        const auto size   = last - first;
+        if (offset + size <= ring.size) return {std::span(ring.data + offset, size), {}};
 
-        // Flush buffer.
-        log->flush(*this);
+        return {std::span(ring.data + offset, ring.size - offset), std::span(ring.data, offset + size - ring.size)};
     }
 }  // namespace lal
@@ -0,0 +1,111 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace lal
+{
+    enum class Timestamps : uint8_t
+    {
+        /**
+         * \brief No timestamps are written.
+         */
+        Disabled = 0,
+
+        /**
+         * \brief Time stamp counter of the CPU (rdtsc, or the virtual counter on AArch64). Falls back to
+         * std::chrono::steady_clock on other architectures.
+         */
+        Tsc = 1,
+
+        /**
+         * \brief CLOCK_MONOTONIC_RAW in nanoseconds. Falls back to std::chrono::steady_clock where it does not exist.
+         */
+        MonotonicRaw = 2
+    };
+
+    /**
+     * \brief Read the clock of a timestamp source. Does not serialize the instruction stream.
+     * \tparam T Timestamp source.
+     * \return Ticks.
+     */
+    template<Timestamps T>
+    [[nodiscard]] inline uint64_t readTimestamp() noexcept
+    {
+        if constexpr (T == Timestamps::Tsc)
+        {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#elif defined(__aarch64__)
+            uint64_t ticks;
+            asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+            return ticks;
+#else
+            return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+        }
+        else if constexpr (T == Timestamps::MonotonicRaw)
+        {
+#ifdef CLOCK_MONOTONIC_RAW
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+            return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000 + static_cast<uint64_t>(ts.tv_nsec);
+#else
+            return static_cast<uint64_t>(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+                .count());
+#endif
+        }
+        else
+            return 0;
+    }
+
+    /**
+     * \brief Relation between the ticks of a timestamp source and wall-clock time, as stored in the format file.
+     */
+    struct Calibration
+    {
+        /**
+         * \brief Timestamp source.
+         */
+        Timestamps source = Timestamps::Disabled;
+
+        /**
+         * \brief Number of ticks per nanosecond.
+         */
+        double ticksPerNs = 1.0;
+
+        /**
+         * \brief Ticks at the anchor point.
+         */
+        uint64_t anchorTicks = 0;
+
+        /**
+         * \brief Wall-clock time at the anchor point, in nanoseconds since the system clock epoch.
+         */
+        int64_t anchorNs = 0;
+
+        /**
+         * \brief Convert ticks to wall-clock time.
+         * \param ticks Ticks.
+         * \return Nanoseconds since the system clock epoch.
+         */
+        [[nodiscard]] int64_t toNanoseconds(const uint64_t ticks) const noexcept
+        {
+            const auto delta = static_cast<double>(static_cast<int64_t>(ticks - anchorTicks));
+            return anchorNs + std::llround(delta / ticksPerNs);
+        }
+    };
+}  // namespace lal
@@ -0,0 +1,170 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+////////////////////////////////////////////////////////////////
+// Current target includes.
+////////////////////////////////////////////////////////////////
+
+#include "logandload/log/writer_backend.h"
+
+struct io_uring;
+
+namespace lal
+{
+    /**
+     * \brief Writer backend that submits writes through io_uring. Large contiguous writes are split over multiple
+     * requests, so that several of them are in flight at once. Writes from registered buffers use fixed buffers. Only
+     * functional when built with LOGANDLOAD_IO_URING.
+     */
+    class UringBackend final : public IWriterBackend
+    {
+    public:
+        ////////////////////////////////////////////////////////////////
+        // Constructors.
+        ////////////////////////////////////////////////////////////////
+
+        UringBackend() = delete;
+
+        /**
+         * \brief Open a file and set up an io_uring instance. Check good() to see if both succeeded.
+         * \param path Path to file. Existing contents are discarded.
+         * \param queueDepth Maximum number of requests in flight.
+         * \param direct If true, bypass the page cache. All writes must then be aligned to directIoAlignment.
+         */
+        UringBackend(const std::filesystem::path& path, uint32_t queueDepth, bool direct);
+
+        UringBackend(const UringBackend&) = delete;
+
+        UringBackend(UringBackend&&) = delete;
+
+        ~UringBackend() noexcept override;
+
+        UringBackend& operator=(const UringBackend&) = delete;
+
+        UringBackend& operator=(UringBackend&&) = delete;
+
+        ////////////////////////////////////////////////////////////////
+        // Getters.
+        ////////////////////////////////////////////////////////////////
+
+        /**
+         * \brief Returns whether io_uring support was compiled in.
+         * \return True or false.
+         */
+        [[nodiscard]] static bool supported() noexcept;
+
+        [[nodiscard]] bool good() const noexcept override;
+
+        [[nodiscard]] size_t pending() const noexcept override;
+
+        ////////////////////////////////////////////////////////////////
+        // Writing.
+        ////////////////////////////////////////////////////////////////
+
+        void registerBuffers(std::span<const WriteSegment> buffers) override;
+
+        void submit(uint64_t offset, const void* data, size_t size, size_t tag) override;
+
+        void submit(uint64_t offset, std::span<WriteSegment> segments, size_t tag) override;
+
+        size_t wait() override;
+
+        [[nodiscard]] std::optional<size_t> poll() override;
+
+    private:
+        ////////////////////////////////////////////////////////////////
+        // Types.
+        ////////////////////////////////////////////////////////////////
+
+        struct Request
+        {
+            size_t tag = 0;
+
+            uint64_t offset = 0;
+
+            /**
+             * \brief Data of a contiguous write.
+             */
+            const uint8_t* data = nullptr;
+
+            size_t size = 0;
+
+            /**
+             * \brief Index of registered buffer that contains data, or -1.
+             */
+            int32_t buffer = -1;
+
+            /**
+             * \brief Segments of a gathered write.
+             */
+            WriteSegment* segments = nullptr;
+
+            size_t segmentCount = 0;
+        };
+
+        /**
+         * \brief Get an unused request, waiting for a completion if all requests are in flight.
+         * \return Request index.
+         */
+        [[nodiscard]] uint32_t acquire();
+
+        /**
+         * \brief Add a submission queue entry for a request.
+         * \param index Request index.
+         */
+        void prepare(uint32_t index);
+
+        /**
+         * \brief Submit all prepared entries and handle a completion.
+         * \param block If true, wait for a completion. Otherwise, only handle one that is already available.
+         * \return True if a completion was handled or the ring failed.
+         */
+        bool reap(bool block);
+
+        /**
+         * \brief Return a request and complete its tag if it was the last request for that tag.
+         * \param index Request index.
+         */
+        void finish(uint32_t index);
+
+        /**
+         * \brief Mark requests of a tag as done and complete the tag if no requests are left.
+         * \param tag Tag.
+         * \param count Number of requests.
+         */
+        void complete(size_t tag, size_t count);
+
+        ////////////////////////////////////////////////////////////////
+        // Member variables.
+        ////////////////////////////////////////////////////////////////
+
+        int fd = -1;
+
+        bool ok = false;
+
+        io_uring* ring = nullptr;
+
+        std::vector<Request> requests;
+
+        std::vector<uint32_t> freeRequests;
+
+        std::vector<WriteSegment> registered;
+
+        /**
+         * \brief Number of requests in flight per tag.
+         */
+        std::unordered_map<size_t, size_t> outstanding;
+
+        /**
+         * \brief Tags of completed writes that were not yet returned by wait.
+         */
+        std::deque<size_t> completed;
+    };
+}  // namespace lal
@@ -0,0 +1,132 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+
+////////////////////////////////////////////////////////////////
+// Current target includes.
+////////////////////////////////////////////////////////////////
+
+#include "logandload/log/log_settings.h"
+
+namespace lal
+{
+    /**
+     * \brief Part of a gathered write. Layout compatible with iovec.
+     */
+    struct WriteSegment
+    {
+        const void* data = nullptr;
+        size_t      size = 0;
+    };
+
+    /**
+     * \brief Interface for the object that writes global buffers to the log file. Writes are submitted with an explicit
+     * file offset and a tag, and can complete asynchronously. Data must stay valid until the write has completed.
+     */
+    class IWriterBackend
+    {
+    public:
+        ////////////////////////////////////////////////////////////////
+        // Constructors.
+        ////////////////////////////////////////////////////////////////
+
+        IWriterBackend() = default;
+
+        IWriterBackend(const IWriterBackend&) = delete;
+
+        IWriterBackend(IWriterBackend&&) = delete;
+
+        virtual ~IWriterBackend() noexcept = default;
+
+        IWriterBackend& operator=(const IWriterBackend&) = delete;
+
+        IWriterBackend& operator=(IWriterBackend&&) = delete;
+
+        ////////////////////////////////////////////////////////////////
+        // Getters.
+        ////////////////////////////////////////////////////////////////
+
+        /**
+         * \brief Returns whether the file is open and no write has failed.
+         * \return True or false.
+         */
+        [[nodiscard]] virtual bool good() const noexcept = 0;
+
+        /**
+         * \brief Number of submitted writes that were not yet returned by wait.
+         * \return Count.
+         */
+        [[nodiscard]] virtual size_t pending() const noexcept = 0;
+
+        ////////////////////////////////////////////////////////////////
+        // Writing.
+        ////////////////////////////////////////////////////////////////
+
+        /**
+         * \brief Register buffers that will be written repeatedly. Backends can use this to avoid mapping the buffers
+         * on each write. Default implementation does nothing.
+         * \param buffers Buffers.
+         */
+        virtual void registerBuffers(std::span<const WriteSegment> buffers);
+
+        /**
+         * \brief Submit a write of a contiguous range.
+         * \param offset File offset.
+         * \param data Data.
+         * \param size Size of data in bytes.
+         * \param tag Value returned by wait once the write has completed.
+         */
+        virtual void submit(uint64_t offset, const void* data, size_t size, size_t tag) = 0;
+
+        /**
+         * \brief Submit a gathered write of a list of segments.
+         * \param offset File offset.
+         * \param segments Segments. Must stay valid until the write has completed. Contents are modified if a write is
+         * only partially completed.
+         * \param tag Value returned by wait once the write has completed.
+         */
+        virtual void submit(uint64_t offset, std::span<WriteSegment> segments, size_t tag) = 0;
+
+        /**
+         * \brief Wait for a submitted write to complete. Must only be called if pending() > 0.
+         * \return Tag of the completed write.
+         */
+        virtual size_t wait() = 0;
+
+        /**
+         * \brief Get a submitted write that has completed, without waiting.
+         * \return Tag of the completed write, or nothing if no write has completed yet.
+         */
+        [[nodiscard]] virtual std::optional<size_t> poll() = 0;
+    };
+
+#ifndef WIN32
+    /**
+     * \brief Open a log file for writing, discarding existing contents.
+     * \param path Path to file.
+     * \param direct If true, bypass the page cache with O_DIRECT (or F_NOCACHE where O_DIRECT does not exist).
+     * \return File descriptor, or -1 on failure.
+     */
+    [[nodiscard]] int openLogFile(const std::filesystem::path& path, bool direct);
+#endif
+
+    using IWriterBackendPtr = std::unique_ptr<IWriterBackend>;
+
+    /**
+     * \brief Create the writer backend selected in the settings. Falls back to the pwrite backend if the selected
+     * backend is not supported by the build or the kernel.
+     * \param path Path to log file. Existing contents are discarded.
+     * \param settings Settings.
+     * \return Writer backend. Check good() to see if the file could be opened.
+     */
+    [[nodiscard]] IWriterBackendPtr createWriterBackend(const std::filesystem::path& path,
+                                                        const LogSettings&           settings);
+}  // namespace lal
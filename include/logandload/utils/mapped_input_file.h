@@ -0,0 +1,83 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace lal
+{
+    /**
+     * \brief Read-only view of a whole input file. On POSIX platforms, the file is memory-mapped and its pages are
+     * faulted in on demand. Elsewhere, it is read into memory. The file must not shrink while it is mapped.
+     */
+    class MappedInputFile
+    {
+    public:
+        ////////////////////////////////////////////////////////////////
+        // Constructors.
+        ////////////////////////////////////////////////////////////////
+
+        MappedInputFile() = delete;
+
+        /**
+         * \brief Map a file.
+         * \param path Path to file.
+         * \throws LalError If the file could not be opened or mapped.
+         */
+        explicit MappedInputFile(const std::filesystem::path& path);
+
+        MappedInputFile(const MappedInputFile&) = delete;
+
+        MappedInputFile(MappedInputFile&&) = delete;
+
+        ~MappedInputFile() noexcept;
+
+        MappedInputFile& operator=(const MappedInputFile&) = delete;
+
+        MappedInputFile& operator=(MappedInputFile&&) = delete;
+
+        ////////////////////////////////////////////////////////////////
+        // Getters.
+        ////////////////////////////////////////////////////////////////
+
+        /**
+         * \brief Get the contents of the file.
+         * \return Contents.
+         */
+        [[nodiscard]] std::span<const std::byte> data() const noexcept;
+
+        ////////////////////////////////////////////////////////////////
+        // Access hints.
+        ////////////////////////////////////////////////////////////////
+
+        /**
+         * \brief Hint that the file is read sequentially, so that pages are read ahead aggressively.
+         */
+        void adviseSequential() const noexcept;
+
+    private:
+        ////////////////////////////////////////////////////////////////
+        // Member variables.
+        ////////////////////////////////////////////////////////////////
+
+        /**
+         * \brief Mapped contents, or nullptr if the file is empty.
+         */
+        std::byte* mapping = nullptr;
+
+        /**
+         * \brief Size of the file in bytes.
+         */
+        size_t size = 0;
+
+        /**
+         * \brief Contents of the file on platforms without mapping.
+         */
+        std::vector<std::byte> buffer;
+    };
+}  // namespace lal
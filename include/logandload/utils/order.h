@@ -0,0 +1,21 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <vector>
+
+namespace lal
+{
+    /**
+     * \brief Reconstruct the total order of messages in a log with Ordering::Timestamp. Messages are sorted by
+     * timestamp, ties are broken by stream index. The order of messages within a stream is always kept, even if their
+     * timestamps are not monotonic.
+     * \param timestamps Per stream, the timestamps of all messages in the order in which they were written.
+     * \return Per stream, the index of each message in the total order.
+     */
+    [[nodiscard]] std::vector<std::vector<uint64_t>>
+      reconstructOrder(const std::vector<std::vector<uint64_t>>& timestamps);
+}  // namespace lal
@@ -7,7 +7,9 @@
 #include <cassert>
 #include <format>
 #include <fstream>
+#include <functional>
 #include <ranges>
+#include <span>
 
 ////////////////////////////////////////////////////////////////
 // Module includes.
@@ -21,7 +23,10 @@
 ////////////////////////////////////////////////////////////////
 
 #include "logandload/analyze/tree.h"
+#include "logandload/log/format_file.h"
+#include "logandload/log/log_file.h"
 #include "logandload/utils/lal_error.h"
+#include "logandload/utils/order.h"
 
 namespace
 {
@@ -56,6 +61,25 @@ namespace lal
         registerParameter<float>();
         registerParameter<double>();
         registerParameter<long double>();
+
+        // Dropped records look like a message with two parameters to users of the tree.
+        droppedType.key     = MessageTypes::Dropped;
+        droppedType.message = "{} messages dropped ({} bytes)";
+        for (size_t i = 0; i < 2; i++)
+        {
+            droppedType.parameters.emplace_back(hashParameter<uint64_t>());
+            droppedType.parameterSize.emplace_back(sizeof(uint64_t));
+            droppedType.messageSize += sizeof(uint64_t);
+        }
+
+        // Suppressed records look like a message with the number of messages and the key of their format type.
+        suppressedType.key     = MessageTypes::Suppressed;
+        suppressedType.message = "{} messages of format {} suppressed";
+        suppressedType.parameters.emplace_back(hashParameter<uint64_t>());
+        suppressedType.parameterSize.emplace_back(sizeof(uint64_t));
+        suppressedType.parameters.emplace_back(hashParameter<uint32_t>());
+        suppressedType.parameterSize.emplace_back(sizeof(MessageKey));
+        suppressedType.messageSize = sizeof(uint64_t) + sizeof(MessageKey);
     }
 
     Analyzer::~Analyzer() noexcept = default;
@@ -68,6 +92,12 @@ namespace lal
 
     size_t Analyzer::getStreamCount() const noexcept { return nodes[0].childCount; }
 
+    uint64_t Analyzer::getDroppedCount() const noexcept { return droppedCount; }
+
+    uint64_t Analyzer::getSuppressedCount() const noexcept { return suppressedCount; }
+
+    const Calibration& Analyzer::getCalibration() const noexcept { return calibration; }
+
     ////////////////////////////////////////////////////////////////
     // ...
     ////////////////////////////////////////////////////////////////
@@ -92,13 +122,11 @@ namespace lal
         const auto length = file.tellg();
         file.seekg(0);
 
-        // Read some settings.
-        file.read(reinterpret_cast<char*>(&streamCount), sizeof streamCount);
-        {
-            int8_t _order = 0;
-            file.read(reinterpret_cast<char*>(&_order), sizeof _order);
-            if (_order) messageOrder = true;
-        }
+        // Read header and settings.
+        const auto settings = readFormatFileSettings(file);
+        streamCount         = settings.streamCount;
+        messageOrder        = settings.order;
+        calibration         = settings.calibration;
 
         // Read list of format types.
         while (file.tellg() != length)
@@ -109,8 +137,9 @@ namespace lal
             file.read(reinterpret_cast<char*>(&formatType.key), sizeof(MessageKey));
 
             // Read format string.
-            size_t len;
+            size_t len = 0;
             file.read(reinterpret_cast<char*>(&len), sizeof(size_t));
+            if (!file || length - file.tellg() < static_cast<std::streamoff>(len)) break;
             auto* str = new char[len];
             file.read(str, static_cast<std::make_signed_t<size_t>>(len));
             formatType.message = std::string(str);
@@ -123,20 +152,44 @@ namespace lal
             file.read(reinterpret_cast<char*>(&formatType.category), sizeof formatType.category);
 
             // Read all parameter keys.
+            bool resolved = true;
             for (size_t i = 0; i < countParameters(formatType.message); i++)
             {
                 ParameterKey paramKey;
                 file.read(reinterpret_cast<char*>(&paramKey), sizeof(ParameterKey));
+                uint8_t variable = 0;
+                if (settings.version > 1) file.read(reinterpret_cast<char*>(&variable), sizeof variable);
 
+                // Variable-length parameters do not need to be registered, their size is stored with the data.
+                if (variable)
+                {
+                    formatType.parameters.emplace_back(paramKey);
+                    formatType.parameterSize.emplace_back(0);
+                    formatType.variableParameters.emplace_back(true);
+                    formatType.variable = true;
+                    continue;
+                }
+
+                // The format file lists all formats of a log type, including formats not used by this log. Skip
+                // those with unregistered parameters. Reading fails once one of them is actually encountered.
                 const auto it = parameters.find(paramKey);
                 if (it == parameters.end())
-                    throw LalError(std::format("Encountered unregistered parameter {} in format file.", paramKey.key));
+                {
+                    resolved = false;
+                    continue;
+                }
 
                 formatType.parameters.emplace_back(paramKey);
                 formatType.parameterSize.emplace_back(it->second);
+                formatType.variableParameters.emplace_back(false);
                 formatType.messageSize += it->second;
             }
 
+            // The format file of a live or crashed process can end in a partially written format.
+            if (!file) break;
+
+            if (!resolved) continue;
+
             if (!formatTypes.try_emplace(formatType.key, std::move(formatType)).second)
                 throw LalError(std::format("Duplicate message {} in format file.", formatType.key.key));
         }
@@ -144,16 +197,32 @@ namespace lal
 
     void Analyzer::readLogFile(const std::filesystem::path& path)
     {
+        // Map log file. Nodes of a previously read log point into its mapping, so they are dropped first. Pages are
+        // read on demand while the file is parsed front to back.
+        nodes.clear();
+        logFile.reset();
+        logFile = std::make_unique<MappedInputFile>(path);
+        logFile->adviseSequential();
+        data = logFile->data();
+
+        // Skip file header.
+        const auto version = decodeLogFileHeader(data);
+        const auto begin   = static_cast<int64_t>(std::min(logFileHeaderSize(version), data.size()));
+
+        // The log of a live or crashed process can end in a partially written or uncommitted block. Cut it off.
         {
-            // Open log file.
-            auto file = std::ifstream(path, std::ios::binary | std::ios::ate);
-            if (!file) throw LalError(std::format("Failed to open log file {}.", path.string()));
-
-            // Read whole file into data.
-            const auto length = file.tellg();
-            file.seekg(0);
-            data.resize(length);
-            file.read(reinterpret_cast<char*>(data.data()), length);
+            auto complete = static_cast<size_t>(begin);
+            while (true)
+            {
+                size_t     streamIndex = 0, blockSize = 0;
+                const auto header      = std::span(data).subspan(complete);
+                const auto headerSize  = decodeBlockHeader(header, version, streamIndex, blockSize);
+                if (headerSize == 0 || streamIndex >= streamCount || blockSize == 0 ||
+                    blockSize > data.size() - complete - headerSize)
+                    break;
+                complete += headerSize + blockSize;
+            }
+            data = data.first(complete);
         }
 
         /*
@@ -167,6 +236,10 @@ namespace lal
         size_t                 messageCount = 0;
         size_t                 regionCount  = 0;
 
+        // Messages and region records are followed by a timestamp if timestamps are enabled.
+        const auto timestampSize =
+          static_cast<int64_t>(calibration.source == Timestamps::Disabled ? 0 : sizeof(uint64_t));
+
         {
             for (size_t i = 0; i < streamCount; i++)
             {
@@ -178,14 +251,13 @@ namespace lal
             std::vector<size_t> activeParentNode(streamCount);
             for (size_t i = 0; i < streamCount; i++) activeParentNode[i] = i;
 
-            auto pos = data.begin();
+            auto pos = data.begin() + begin;
             while (pos < data.end())
             {
                 // Read block info.
-                const auto& streamIndex = reinterpret_cast<size_t&>(*pos);
-                pos += sizeof streamIndex;
-                const auto& blockSize = reinterpret_cast<size_t&>(*pos);
-                pos += sizeof blockSize;
+                size_t     streamIndex = 0, blockSize = 0;
+                const auto header      = std::span(pos, data.end());
+                pos += static_cast<int64_t>(decodeBlockHeader(header, version, streamIndex, blockSize));
 
                 auto* parentNode = &groupNodes[activeParentNode[streamIndex]];
 
@@ -193,11 +265,13 @@ namespace lal
                 auto blockEnd = pos + static_cast<int64_t>(blockSize);
                 while (pos < blockEnd)
                 {
-                    const auto& key = reinterpret_cast<MessageKey&>(*pos);
+                    const auto& key = reinterpret_cast<const MessageKey&>(*pos);
                     pos += sizeof key;
 
                     if (key == MessageTypes::AnonymousRegionStart)
                     {
+                        pos += timestampSize;
+
                         parentNode->groupChildCount++;
 
                         // Create new node.
@@ -211,8 +285,9 @@ namespace lal
                     }
                     else if (key == MessageTypes::NamedRegionStart)
                     {
-                        const auto& key2 = reinterpret_cast<MessageKey&>(*pos);
+                        const auto& key2 = reinterpret_cast<const MessageKey&>(*pos);
                         pos += sizeof key2;
+                        pos += timestampSize;
                         assert(formatTypes.contains(key2));
 
                         parentNode->groupChildCount++;
@@ -229,18 +304,43 @@ namespace lal
                     }
                     else if (key == MessageTypes::RegionEnd)
                     {
+                        pos += timestampSize;
+
+                        // The start of the region can be missing from a flight recorder dump.
+                        if (parentNode->index < streamCount) continue;
+
                         parentNode                    = &groupNodes[parentNode->parent];
                         activeParentNode[streamIndex] = parentNode->index;
                     }
+                    else if (key == MessageTypes::Dropped)
+                    {
+                        pos += static_cast<int64_t>(droppedType.messageSize);
+
+                        parentNode->messageChildCount++;
+
+                        messageCount++;
+                    }
+                    else if (key == MessageTypes::Suppressed)
+                    {
+                        pos += static_cast<int64_t>(suppressedType.messageSize);
+
+                        parentNode->messageChildCount++;
+
+                        messageCount++;
+                    }
                     else
                     {
+                        // Skip message index and timestamp.
+                        if (messageOrder == Ordering::Enabled) pos += static_cast<int64_t>(sizeof(uint64_t));
+                        pos += timestampSize;
+
                         // Find format type to skip parameter data.
                         const auto it = formatTypes.find(key);
-                        assert(it != formatTypes.end());
-                        pos += static_cast<int64_t>(it->second.messageSize);
-
-                        // Skip message index.
-                        if (messageOrder) pos += static_cast<int64_t>(sizeof(uint64_t));
+                        if (it == formatTypes.end())
+                            throw LalError(std::format(
+                              "Encountered unknown message {} in log file. Are all its parameters registered?", key.key));
+                        pos += static_cast<int64_t>(
+                          it->second.getSize(data.data() + std::distance(data.begin(), pos)));
 
                         parentNode->messageChildCount++;
 
@@ -295,14 +395,13 @@ namespace lal
             std::vector<Node*> activeParentNode(streamCount);
             for (size_t i = 0; i < streamCount; i++) activeParentNode[i] = nodes.data() + i + 1;
 
-            auto pos = data.begin();
+            auto pos = data.begin() + begin;
             while (pos < data.end())
             {
                 // Read block info.
-                const auto& streamIndex = reinterpret_cast<size_t&>(*pos);
-                pos += sizeof streamIndex;
-                const auto& blockSize = reinterpret_cast<size_t&>(*pos);
-                pos += sizeof blockSize;
+                size_t     streamIndex = 0, blockSize = 0;
+                const auto header      = std::span(pos, data.end());
+                pos += static_cast<int64_t>(decodeBlockHeader(header, version, streamIndex, blockSize));
 
                 auto* parentNode = activeParentNode[streamIndex];
 
@@ -310,7 +409,7 @@ namespace lal
                 auto blockEnd = pos + static_cast<int64_t>(blockSize);
                 while (pos < blockEnd)
                 {
-                    const auto& key = reinterpret_cast<MessageKey&>(*pos);
+                    const auto& key = reinterpret_cast<const MessageKey&>(*pos);
                     pos += sizeof key;
 
                     if (key == MessageTypes::AnonymousRegionStart)
@@ -319,6 +418,11 @@ namespace lal
                         auto& node  = *(parentNode->firstChild + parentNode->childCount++);
                         node.type   = Node::Type::Region;
                         node.parent = parentNode;
+                        if (timestampSize)
+                        {
+                            node.timestamp = reinterpret_cast<const uint64_t&>(*pos);
+                            pos += timestampSize;
+                        }
 
                         // Assign offset to first child.
                         if (const auto& groupNode = groupNodes[nextGroupIndex++];
@@ -334,7 +438,7 @@ namespace lal
                     }
                     else if (key == MessageTypes::NamedRegionStart)
                     {
-                        const auto& key2 = reinterpret_cast<MessageKey&>(*pos);
+                        const auto& key2 = reinterpret_cast<const MessageKey&>(*pos);
                         pos += sizeof key2;
                         const auto it = formatTypes.find(key2);
                         assert(it != formatTypes.end());
@@ -344,6 +448,11 @@ namespace lal
                         node.type       = Node::Type::Region;
                         node.formatType = &it->second;
                         node.parent     = parentNode;
+                        if (timestampSize)
+                        {
+                            node.timestamp = reinterpret_cast<const uint64_t&>(*pos);
+                            pos += timestampSize;
+                        }
 
                         // Assign offset to first child.
                         if (const auto& groupNode = groupNodes[nextGroupIndex++];
@@ -359,10 +468,47 @@ namespace lal
                     }
                     else if (key == MessageTypes::RegionEnd)
                     {
+                        // The start of the region can be missing from a flight recorder dump.
+                        if (parentNode->type == Node::Type::Stream)
+                        {
+                            pos += timestampSize;
+                            continue;
+                        }
+
+                        if (timestampSize)
+                        {
+                            parentNode->endTimestamp = reinterpret_cast<const uint64_t&>(*pos);
+                            pos += timestampSize;
+                        }
+
                         // Update parent node for current stream.
                         parentNode                    = parentNode->parent;
                         activeParentNode[streamIndex] = parentNode;
                     }
+                    else if (key == MessageTypes::Dropped)
+                    {
+                        // Initialize dropped node at next position in child node range of parent.
+                        auto& node      = *(parentNode->firstChild + parentNode->childCount++);
+                        node.type       = Node::Type::Dropped;
+                        node.formatType = &droppedType;
+                        node.parent     = parentNode;
+                        node.data       = data.data() + std::distance(data.begin(), pos);
+                        pos += static_cast<int64_t>(droppedType.messageSize);
+
+                        droppedCount += node.get<uint64_t>(0);
+                    }
+                    else if (key == MessageTypes::Suppressed)
+                    {
+                        // Initialize suppressed node at next position in child node range of parent.
+                        auto& node      = *(parentNode->firstChild + parentNode->childCount++);
+                        node.type       = Node::Type::Suppressed;
+                        node.formatType = &suppressedType;
+                        node.parent     = parentNode;
+                        node.data       = data.data() + std::distance(data.begin(), pos);
+                        pos += static_cast<int64_t>(suppressedType.messageSize);
+
+                        suppressedCount += node.get<uint64_t>(0);
+                    }
                     else
                     {
                         const auto it = formatTypes.find(key);
@@ -372,15 +518,20 @@ namespace lal
                         auto& node      = *(parentNode->firstChild + parentNode->childCount++);
                         node.type       = Node::Type::Message;
                         node.formatType = &it->second;
-                        if (messageOrder)
+                        if (messageOrder == Ordering::Enabled)
                         {
-                            node.index = reinterpret_cast<size_t&>(*pos);
+                            node.index = reinterpret_cast<const size_t&>(*pos);
                             pos += static_cast<int64_t>(sizeof(uint64_t));
                         }
+                        if (timestampSize)
+                        {
+                            node.timestamp = reinterpret_cast<const uint64_t&>(*pos);
+                            pos += timestampSize;
+                        }
                         node.parent = parentNode;
 
                         // Assign parameter data.
-                        const auto size = it->second.messageSize;
+                        const auto size = it->second.getSize(data.data() + std::distance(data.begin(), pos));
                         if (size)
                         {
 
@@ -393,6 +544,36 @@ namespace lal
             }
             assert(pos == data.end());
         }
+
+        /*
+         * With timestamp ordering, messages do not have an index. Reconstruct it from the timestamps.
+         */
+
+        if (messageOrder == Ordering::Timestamp)
+        {
+            // Collect the messages of each stream in the order in which they were written.
+            std::vector<std::vector<Node*>>    messages(streamCount);
+            std::vector<std::vector<uint64_t>> timestamps(streamCount);
+            std::function<void(Node&, size_t)> collect;
+            collect = [&](Node& node, const size_t stream) {
+                for (size_t i = 0; i < node.childCount; i++)
+                {
+                    auto& child = *(node.firstChild + i);
+                    if (child.type == Node::Type::Message)
+                    {
+                        messages[stream].push_back(&child);
+                        timestamps[stream].push_back(child.timestamp);
+                    }
+                    else if (child.type == Node::Type::Region)
+                        collect(child, stream);
+                }
+            };
+            for (size_t i = 0; i < streamCount; i++) collect(nodes[i + 1], i);
+
+            const auto indices = reconstructOrder(timestamps);
+            for (size_t i = 0; i < streamCount; i++)
+                for (size_t j = 0; j < messages[i].size(); j++) messages[i][j]->index = indices[i][j];
+        }
     }
 
     void Analyzer::writeGraph(const std::filesystem::path& path, const Tree* tree) const
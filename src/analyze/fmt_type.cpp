@@ -27,4 +27,24 @@ namespace lal
 
         return true;
     }
+
+    size_t FormatType::getSize(const std::byte* data) const noexcept
+    {
+        if (!variable) return messageSize;
+        return getOffset(data, parameters.size());
+    }
+
+    size_t FormatType::getOffset(const std::byte* data, const size_t index) const noexcept
+    {
+        size_t offset = 0;
+        for (size_t i = 0; i < index; i++)
+        {
+            // Variable-length parameters are preceded by their size.
+            if (variableParameters[i])
+                offset += sizeof(uint32_t) + *reinterpret_cast<const uint32_t*>(data + offset);
+            else
+                offset += parameterSize[i];
+        }
+        return offset;
+    }
 }  // namespace lal
@@ -33,4 +33,14 @@ namespace lal
         return std::distance(analyzer.getNodes().data(), this);
     }
 
+    int64_t Node::getTime(const Analyzer& analyzer) const noexcept
+    {
+        return analyzer.getCalibration().toNanoseconds(timestamp);
+    }
+
+    int64_t Node::getEndTime(const Analyzer& analyzer) const noexcept
+    {
+        return analyzer.getCalibration().toNanoseconds(endTimestamp);
+    }
+
 }  // namespace lal
@@ -2,7 +2,10 @@
 
 namespace lal
 {
-    FormatState::FormatState(const uint32_t indent, const char character) : indent(indent), character(character) {}
+    FormatState::FormatState(const uint32_t indent, const char character, std::string prefix) :
+        indent(indent), character(character), regionPrepend(std::move(prefix))
+    {
+    }
 
     void FormatState::pushRegion(std::string name)
     {
@@ -18,5 +21,9 @@ namespace lal
         return name;
     }
 
+    bool FormatState::hasRegion() const noexcept { return !regionStack.empty(); }
+
     std::string& FormatState::getRegionPrepend() { return regionPrepend; }
+
+    size_t FormatState::nextMessage() { return messageCount++; }
 }  // namespace lal
@@ -4,14 +4,279 @@
 // Standard includes.
 ////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
 #include <format>
+#include <iomanip>
+#include <mutex>
+#include <queue>
 #include <ranges>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 
 ////////////////////////////////////////////////////////////////
 // Current target includes.
 ////////////////////////////////////////////////////////////////
 
+#include "logandload/log/format_file.h"
+#include "logandload/log/log_file.h"
 #include "logandload/utils/lal_error.h"
+#include "logandload/utils/mapped_input_file.h"
+#include "logandload/utils/order.h"
+
+namespace
+{
+    /**
+     * \brief Read a trivially copyable value from possibly unaligned data.
+     * \tparam T Value type.
+     * \param in Pointer to data.
+     * \param value Value.
+     * \return Pointer past the value.
+     */
+    template<typename T>
+    const std::byte* read(const std::byte* in, T& value) noexcept
+    {
+        std::memcpy(&value, in, sizeof(T));
+        return in + sizeof(T);
+    }
+
+    /**
+     * \brief Default category formatting, which writes the integer with a | as separator at the end.
+     */
+    struct CategoryFormatter
+    {
+        void operator()(std::ostream& out, const uint32_t c) const { out << c << " | "; }
+
+        void append(lal::OutputBuffer& out, const uint32_t c) const
+        {
+            out.appendNumber(c);
+            out.append(" | ");
+        }
+    };
+
+    /**
+     * \brief Default index formatting, which pads the index with a | as separator at the end.
+     */
+    struct IndexFormatter
+    {
+        const lal::Formatter* formatter;
+
+        void operator()(std::ostream& out, const uint64_t i) const
+        {
+            // Get old padding settings.
+            const auto width = out.width();
+            const auto fill  = out.fill();
+            // Set padding.
+            if (formatter->indexPaddingWidth > 0)
+                out << std::setw(formatter->indexPaddingWidth) << std::setfill(formatter->indexPaddingCharacter);
+            // Write index and restore padding.
+            out << i << std::setw(width) << std::setfill(fill) << " | ";
+        }
+
+        void append(lal::OutputBuffer& out, const uint64_t i) const
+        {
+            const auto width = static_cast<size_t>(std::max(formatter->indexPaddingWidth, 0));
+            out.appendPadded(i, width, formatter->indexPaddingCharacter);
+            out.append(" | ");
+        }
+    };
+
+    /**
+     * \brief Default timestamp formatting, which writes UTC date and time with a | as separator at the end.
+     */
+    struct TimestampFormatter
+    {
+        void operator()(std::ostream& out, const int64_t ns) const
+        {
+            out << std::format("{:%F %T} | ", std::chrono::sys_time<std::chrono::nanoseconds>(std::chrono::nanoseconds(ns)));
+        }
+
+        void append(lal::OutputBuffer& out, const int64_t ns) const
+        {
+            const auto time = std::chrono::sys_time<std::chrono::nanoseconds>(std::chrono::nanoseconds(ns));
+            const auto day  = std::chrono::floor<std::chrono::days>(time);
+            const auto date = std::chrono::year_month_day(day);
+
+            // Years that do not have exactly 4 digits are rare enough to leave them to std::format.
+            const auto year = static_cast<int32_t>(date.year());
+            if (year < 0 || year > 9999)
+            {
+                (*this)(out.stream(), ns);
+                return;
+            }
+
+            // Same as "%F %T": date, time and 9 fractional digits.
+            const auto sinceMidnight = static_cast<uint64_t>((time - day).count());
+            const auto seconds       = sinceMidnight / 1'000'000'000;
+            out.appendPadded(static_cast<uint64_t>(year), 4, '0');
+            out.append('-');
+            out.appendPadded(static_cast<unsigned>(date.month()), 2, '0');
+            out.append('-');
+            out.appendPadded(static_cast<unsigned>(date.day()), 2, '0');
+            out.append(' ');
+            out.appendPadded(seconds / 3600, 2, '0');
+            out.append(':');
+            out.appendPadded(seconds / 60 % 60, 2, '0');
+            out.append(':');
+            out.appendPadded(seconds % 60, 2, '0');
+            out.append('.');
+            out.appendPadded(sinceMidnight % 1'000'000'000, 9, '0');
+            out.append(" | ");
+        }
+    };
+
+    /**
+     * \brief Collect the blocks of each stream. Only block headers are read.
+     * \param data Blocks, starting at a block header.
+     * \param version Log file version.
+     * \return Per stream, the data of each complete block.
+     */
+    std::vector<std::vector<std::span<const std::byte>>> collectBlocks(const std::span<const std::byte> data,
+                                                                       const uint32_t                   version)
+    {
+        std::vector<std::vector<std::span<const std::byte>>> blocks;
+        size_t                                               offset = 0;
+        while (offset != data.size())
+        {
+            size_t     streamIndex = 0, blockSize = 0;
+            const auto header      = lal::decodeBlockHeader(data.subspan(offset), version, streamIndex, blockSize);
+            if (header == 0 || blockSize == 0 || data.size() - offset - header < blockSize) break;
+
+            if (streamIndex >= blocks.size()) blocks.resize(streamIndex + 1);
+            blocks[streamIndex].push_back(data.subspan(offset + header, blockSize));
+            offset += header + blockSize;
+        }
+
+        return blocks;
+    }
+
+    /**
+     * \brief Check whether a message key belongs to a message, which has an index, or to another record.
+     * \param key Message key.
+     * \return True for a message.
+     */
+    bool isMessage(const lal::MessageKey key) noexcept
+    {
+        switch (key.key)
+        {
+        case lal::MessageTypes::AnonymousRegionStart.key:
+        case lal::MessageTypes::NamedRegionStart.key:
+        case lal::MessageTypes::RegionEnd.key:
+        case lal::MessageTypes::Dropped.key:
+        case lal::MessageTypes::Suppressed.key: return false;
+        default: return true;
+        }
+    }
+
+    /**
+     * \brief Position in a stream of merged output.
+     */
+    struct StreamCursor
+    {
+        /**
+         * \brief Data of each block of the stream.
+         */
+        std::vector<std::span<const std::byte>> blocks;
+
+        /**
+         * \brief Index of the current block.
+         */
+        size_t block = 0;
+
+        /**
+         * \brief Unread data of the current block.
+         */
+        std::span<const std::byte> remaining;
+
+        lal::FormatState state;
+
+        /**
+         * \brief Sort key of the last message that was formatted. Only used with timestamp ordering.
+         */
+        uint64_t last = 0;
+
+        /**
+         * \brief Move to the next block if the current one was read completely.
+         * \return False if the whole stream was read.
+         */
+        bool next() noexcept
+        {
+            while (remaining.empty() && block + 1 < blocks.size()) remaining = blocks[++block];
+            return !remaining.empty();
+        }
+
+        /**
+         * \brief Get the sort key of the next message, skipping other records. This is the message index, or with
+         * timestamp ordering the timestamp. A key is never less than that of the previous message, so that the order
+         * of messages within a stream is kept even if their timestamps are not monotonic (see reconstructOrder).
+         * \param order Message ordering.
+         * \param timestampSize Size of the timestamp of each record.
+         * \return Sort key, or the maximum value if there are no messages left.
+         */
+        [[nodiscard]] uint64_t nextKey(const lal::Ordering order, const size_t timestampSize) const
+        {
+            // The index or timestamp is stored right after the key of the next message, which can be in a later
+            // block.
+            auto i    = block;
+            auto data = remaining;
+            while (true)
+            {
+                while (data.empty())
+                {
+                    if (++i >= blocks.size()) return UINT64_MAX;
+                    data = blocks[i];
+                }
+
+                lal::MessageKey key;
+                const auto*     in = read(data.data(), key);
+                switch (key.key)
+                {
+                case lal::MessageTypes::AnonymousRegionStart.key:
+                case lal::MessageTypes::RegionEnd.key: in += timestampSize; break;
+                case lal::MessageTypes::NamedRegionStart.key: in += sizeof(lal::MessageKey) + timestampSize; break;
+                case lal::MessageTypes::Dropped.key: in += sizeof(uint64_t) * 2; break;
+                case lal::MessageTypes::Suppressed.key: in += sizeof(uint64_t) + sizeof(lal::MessageKey); break;
+                default:
+                {
+                    uint64_t value = 0;
+                    std::ignore    = read(in, value);
+                    return order == lal::Ordering::Timestamp ? std::max(value, last) : value;
+                }
+                }
+                data = data.subspan(std::min(static_cast<size_t>(in - data.data()), data.size()));
+            }
+        }
+    };
+
+    /**
+     * \brief Size from which the buffer of merged output is written to the file.
+     */
+    constexpr size_t mergedFlushSize = 1 << 16;
+
+    /**
+     * \brief Call a formatting function. If it is the default function, its output is appended to the buffer directly
+     * instead of going through the stream of the buffer.
+     * \tparam Default Type of the default function.
+     * \param f Formatting function.
+     * \param out Output buffer.
+     * \param args Arguments.
+     */
+    template<typename Default, typename... Args>
+    void callFormatter(const std::function<void(std::ostream&, Args...)>& f,
+                       lal::OutputBuffer&                                 out,
+                       std::type_identity_t<Args>... args)
+    {
+        if (const auto* builtin = f.template target<Default>())
+            builtin->append(out, args...);
+        else
+            f(out.stream(), args...);
+    }
+}  // namespace
 
 namespace lal
 {
@@ -21,39 +286,41 @@ namespace lal
 
     Formatter::Formatter()
     {
-        // Register default parameters.
-        registerParameter<int8_t>([](std::ostream& out, const int8_t val) { out << val; });
-        registerParameter<uint8_t>([](std::ostream& out, const uint8_t val) { out << val; });
-        registerParameter<int16_t>([](std::ostream& out, const int16_t val) { out << val; });
-        registerParameter<uint16_t>([](std::ostream& out, const uint16_t val) { out << val; });
-        registerParameter<int32_t>([](std::ostream& out, const int32_t val) { out << val; });
-        registerParameter<uint32_t>([](std::ostream& out, const uint32_t val) { out << val; });
-        registerParameter<int64_t>([](std::ostream& out, const int64_t val) { out << val; });
-        registerParameter<uint64_t>([](std::ostream& out, const uint64_t val) { out << val; });
-        registerParameter<std::byte>([](std::ostream& out, const std::byte val) { out << static_cast<uint32_t>(val); });
-        registerParameter<float>([](std::ostream& out, const float val) { out << val; });
-        registerParameter<double>([](std::ostream& out, const double val) { out << val; });
-        registerParameter<long double>([](std::ostream& out, const long double val) { out << val; });
+        // Register default parameters. They are appended to the output buffer with std::to_chars, which gives the same
+        // result as operator<<.
+        registerBuiltinParameter<int8_t,
+                                 uint8_t,
+                                 int16_t,
+                                 uint16_t,
+                                 int32_t,
+                                 uint32_t,
+                                 int64_t,
+                                 uint64_t,
+                                 std::byte,
+                                 float,
+                                 double,
+                                 long double,
+                                 std::string_view>();
 
         // Default filename formatting adds "_index" and replaces the last extension by .txt.
         filenameFormatter = [](const std::filesystem::path& path, const size_t index) -> std::filesystem::path {
             return path.stem().string() + "_" + std::to_string(index) + ".txt";
         };
 
-        // Default category formatting just writes the integer with a | as separator at the end.
-        categoryFormatter = [](std::ostream& out, const uint32_t c) { out << c << " | "; };
-
-        // Default index formatting pads the index with a | as separator at the end.
-        indexFormatter = [this](std::ostream& out, const uint64_t i) {
-            // Get old padding settings.
-            const auto width = out.width();
-            const auto fill  = out.fill();
-            // Set padding.
-            if (indexPaddingWidth > 0) out << std::setw(indexPaddingWidth) << std::setfill(indexPaddingCharacter);
-            // Write index and restore padding.
-            out << i << std::setw(width) << std::setfill(fill) << " | ";
+        // Default merged filename formatting replaces the last extension by .txt.
+        mergedFilenameFormatter = [](const std::filesystem::path& path) -> std::filesystem::path {
+            return path.stem().string() + ".txt";
         };
 
+        // Default stream formatting writes the stream index with a | as separator at the end.
+        streamFormatter = [](std::ostream& out, const size_t index) { out << index << " | "; };
+
+        // Default category, index and timestamp formatting. These are recognized while formatting and appended to the
+        // output buffer directly.
+        categoryFormatter  = CategoryFormatter{};
+        indexFormatter     = IndexFormatter{this};
+        timestampFormatter = TimestampFormatter{};
+
         // Default anonymous region formatting.
         anonymousRegionFormatter = [](std::ostream& out, const bool start) {
             if (start)
@@ -70,10 +337,25 @@ namespace lal
                 out << "-- REGION END: ";
             out << name << " --";
         };
+
+        // Default dropped messages formatting.
+        droppedFormatter = [](std::ostream& out, const uint64_t messages, const uint64_t bytes) {
+            out << "-- DROPPED: " << messages << " MESSAGES (" << bytes << " BYTES) --";
+        };
+
+        // Default suppressed messages formatting.
+        suppressedFormatter = [](std::ostream& out, const uint64_t messages, const std::string& message) {
+            out << "-- SUPPRESSED: " << messages << " MESSAGES (" << message << ") --";
+        };
     }
 
     Formatter::~Formatter() noexcept = default;
 
+    Formatter::Output::Output(const std::filesystem::path& path, const uint32_t indent, const char character) :
+        file(path), state(indent, character)
+    {
+    }
+
     ////////////////////////////////////////////////////////////////
     // ...
     ////////////////////////////////////////////////////////////////
@@ -88,7 +370,87 @@ namespace lal
         return true;
     }
 
-    std::pair<bool, MessageFormatterMap> Formatter::createFormatters(const std::filesystem::path& fmtPath)
+    bool Formatter::follow(const std::filesystem::path&    path,
+                           const std::stop_token           token,
+                           const std::chrono::milliseconds interval)
+    {
+        auto fmtPath = path;
+        fmtPath += ".fmt";
+
+        // State that is kept across polls.
+        MessageFormatterMap    formatters;
+        Ordering               order   = Ordering::Disabled;
+        uintmax_t              fmtSize = 0;
+        uintmax_t              offset  = 0;
+        uint32_t               version = 1;
+        OutputMap              outputs;
+        std::vector<std::byte> buffer;
+
+        std::mutex                  mutex;
+        std::condition_variable_any cv;
+        std::unique_lock            lock(mutex);
+
+        while (true)
+        {
+            // Do a last poll after a stop was requested, so that all data written until then is formatted.
+            const auto stop = token.stop_requested();
+
+            // Formats are written before the data that uses them, so the format file must be read after determining the
+            // length of the log file.
+            std::error_code ec;
+            const auto      length = std::filesystem::file_size(path, ec);
+
+            // The version is determined from the start of the file until the first block was formatted. Files without
+            // file header are at least as long as one before anything can be formatted.
+            const auto ready = !ec && (offset > 0 || length >= sizeof(LogFileHeader));
+            if (ready && length > offset)
+            {
+                // Reread the format file if it changed.
+                if (const auto size = std::filesystem::file_size(fmtPath, ec); !ec && size != fmtSize)
+                {
+                    std::tie(order, formatters) = createFormatters(fmtPath);
+                    fmtSize                     = size;
+                }
+
+                // Read the data that was appended since the last poll. The file is not mapped, because a writer can
+                // still truncate it.
+                auto in = std::ifstream(path, std::ios::binary);
+                if (!in) throw LalError(std::format("Failed to open log file {}.", path.string()));
+                in.seekg(static_cast<std::streamoff>(offset));
+                buffer.resize(length - offset);
+                in.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+                buffer.resize(static_cast<size_t>(in.gcount()));
+
+                auto data = std::span<const std::byte>(buffer);
+                if (offset == 0)
+                {
+                    version           = decodeLogFileHeader(data);
+                    const auto header = std::min(logFileHeaderSize(version), data.size());
+                    data              = data.subspan(header);
+                    offset += header;
+                }
+
+                // The message index of timestamp ordering can only be reconstructed from the whole log, so it is
+                // formatted without index.
+                offset += writeBlocks(path,
+                                      data,
+                                      version,
+                                      order == Ordering::Timestamp ? Ordering::Disabled : order,
+                                      formatters,
+                                      outputs,
+                                      {});
+
+                for (auto& [index, output] : outputs) output.file.flush();
+            }
+
+            if (stop) break;
+            cv.wait_for(lock, token, interval, [] { return false; });
+        }
+
+        return true;
+    }
+
+    std::pair<Ordering, MessageFormatterMap> Formatter::createFormatters(const std::filesystem::path& fmtPath)
     {
         MessageFormatterMap formatters;
 
@@ -99,16 +461,10 @@ namespace lal
         const auto length = file.tellg();
         file.seekg(0);
 
-        // TODO: Skipping streamCount for now, but the writeLog could be improved by preallocating a vector of outputs instead of using a dict.
-        file.seekg(sizeof(size_t));
-
-        // Read message order setting.
-        bool messageOrder = false;
-        {
-            int8_t _order = 0;
-            file.read(reinterpret_cast<char*>(&_order), sizeof(int8_t));
-            if (_order) messageOrder = true;
-        }
+        // Read header and settings. TODO: The number of streams could be used by writeLog to preallocate a vector of
+        // outputs instead of using a dict.
+        const auto settings = readFormatFileSettings(file);
+        calibration         = settings.calibration;
 
         while (file.tellg() != length)
         {
@@ -117,8 +473,9 @@ namespace lal
             file.read(reinterpret_cast<char*>(&key), sizeof(MessageKey));
 
             // Read format string.
-            size_t len;
+            size_t len = 0;
             file.read(reinterpret_cast<char*>(&len), sizeof(size_t));
+            if (!file || length - file.tellg() < static_cast<std::streamoff>(len)) break;
             auto* str = new char[len];
             file.read(str, static_cast<std::make_signed_t<size_t>>(len));
             auto format = std::string(str);
@@ -135,8 +492,19 @@ namespace lal
                 ParameterKey paramKey;
                 file.read(reinterpret_cast<char*>(&paramKey), sizeof(ParameterKey));
                 parameters.push_back(paramKey);
+
+                // Parameter formatters know whether their type has a variable length.
+                if (settings.version > 1) file.ignore(sizeof(uint8_t));
             }
 
+            // The format file of a live or crashed process can end in a partially written format.
+            if (!file) break;
+
+            // The format file lists all formats of a log type, including formats not used by this log. Skip those
+            // with unregistered parameters. Formatting fails once one of them is actually encountered.
+            if (!std::ranges::all_of(parameters, [this](const ParameterKey p) { return parameterFormatters.contains(p); }))
+                continue;
+
             // Add to dictionary.
             const auto [it, added] = formatters.try_emplace(
               key, std::make_unique<MessageFormatter>(std::move(format), category, parameters, parameterFormatters));
@@ -144,134 +512,433 @@ namespace lal
             if (!added) throw LalError("Duplicate format type key detected.");
         }
 
-        return {messageOrder, std::move(formatters)};
+        return {settings.order, std::move(formatters)};
     }
 
     void Formatter::writeLog(const std::filesystem::path& path,
-                             const bool                   messageOrder,
+                             const Ordering               messageOrder,
                              MessageFormatterMap&         messageFormatters)
     {
-        // Open binary log file.
-        auto in = std::ifstream(path, std::ios::binary | std::ios::ate);
-        if (!in) throw LalError(std::format("Failed to open log file {}.", path.string()));
+        if (mergeStreams && messageOrder == Ordering::Disabled)
+            throw LalError("Merged output requires a log with message ordering.");
 
-        const auto length = in.tellg();
-        in.seekg(0);
+        // Map binary log file. Messages are decoded straight from the mapping.
+        const MappedInputFile file(path);
+        file.adviseSequential();
+        const auto data = file.data();
 
-        std::unordered_map<size_t, std::pair<std::ofstream, FormatState>> outputs;
+        const auto version = decodeLogFileHeader(data);
+        const auto blocks  = data.subspan(std::min(logFileHeaderSize(version), data.size()));
+        if (mergeStreams)
+        {
+            // Merging reconstructs the message index of timestamp ordering on the fly.
+            writeMerged(path, blocks, version, messageOrder, messageFormatters);
+            return;
+        }
+
+        // Reconstruct message index before formatting.
+        std::vector<std::vector<uint64_t>> indices;
+        if (messageOrder == Ordering::Timestamp) indices = readOrder(data, messageFormatters);
 
-        while (in.tellg() != length)
+        if (threadCount == 1)
+        {
+            OutputMap outputs;
+            std::ignore = writeBlocks(path, blocks, version, messageOrder, messageFormatters, outputs, indices);
+        }
+        else
+            writeStreams(path, blocks, version, messageOrder, messageFormatters, indices);
+    }
+
+    size_t Formatter::writeBlocks(const std::filesystem::path&              path,
+                                  const std::span<const std::byte>          data,
+                                  const uint32_t                            version,
+                                  const Ordering                            messageOrder,
+                                  MessageFormatterMap&                      messageFormatters,
+                                  OutputMap&                                outputs,
+                                  const std::vector<std::vector<uint64_t>>& indices)
+    {
+        size_t offset = 0;
+        while (offset != data.size())
         {
             // Read stream index and block size.
-            size_t streamIndex = 0, blockSize = 0;
-            in.read(reinterpret_cast<char*>(&streamIndex), sizeof streamIndex);
-            in.read(reinterpret_cast<char*>(&blockSize), sizeof blockSize);
+            size_t     streamIndex = 0, blockSize = 0;
+            const auto header      = decodeBlockHeader(data.subspan(offset), version, streamIndex, blockSize);
+
+            // The log of a live or crashed process can end in a partially written block. Blocks are never empty, so an
+            // empty block is a part of the file that was not written or committed yet.
+            if (header == 0 || blockSize == 0 || data.size() - offset - header < blockSize) break;
+
+            // Get output, which is created if it does not exist yet.
+            auto it = outputs.find(streamIndex);
+            if (it == outputs.end())
+            {
+                const auto outPath = filenameFormatter(path, streamIndex);
+                it = outputs.try_emplace(streamIndex, outPath, regionIndent, regionIndentCharacter).first;
+            }
+            auto& output = it->second;
+
+            // Format block and write it at once.
+            const auto block = data.subspan(offset + header, blockSize);
+            writeBlock(block, streamIndex, messageOrder, messageFormatters, output.buffer, output.state, indices);
+            output.buffer.writeTo(output.file);
+
+            offset += header + blockSize;
+        }
+
+        return offset;
+    }
+
+    void Formatter::writeStreams(const std::filesystem::path&              path,
+                                 const std::span<const std::byte>          data,
+                                 const uint32_t                            version,
+                                 const Ordering                            messageOrder,
+                                 MessageFormatterMap&                      messageFormatters,
+                                 const std::vector<std::vector<uint64_t>>& indices)
+    {
+        const auto blocks = collectBlocks(data, version);
+
+        // Each worker takes the next stream that was not taken yet and formats it completely, so that the output of a
+        // stream is written in order. The first error stops all workers and is rethrown.
+        std::atomic_size_t next = 0;
+        std::mutex         mutex;
+        std::exception_ptr error;
+
+        const auto work = [&] {
+            try
+            {
+                for (auto i = next++; i < blocks.size(); i = next++)
+                {
+                    if (blocks[i].empty()) continue;
+
+                    Output output(filenameFormatter(path, i), regionIndent, regionIndentCharacter);
+                    for (const auto& block : blocks[i])
+                    {
+                        writeBlock(block, i, messageOrder, messageFormatters, output.buffer, output.state, indices);
+                        output.buffer.writeTo(output.file);
+                    }
+                }
+            }
+            catch (...)
+            {
+                std::scoped_lock lock(mutex);
+                if (!error) error = std::current_exception();
+                next = blocks.size();
+            }
+        };
+
+        // The calling thread is one of the workers.
+        {
+            const auto count = std::min<size_t>(
+              threadCount > 0 ? threadCount : std::max(std::thread::hardware_concurrency(), 1u), blocks.size());
+            std::vector<std::jthread> workers;
+            for (size_t i = 1; i < count; i++) workers.emplace_back(work);
+            work();
+        }
+
+        if (error) std::rethrow_exception(error);
+    }
+
+    void Formatter::writeMerged(const std::filesystem::path&     path,
+                                const std::span<const std::byte> data,
+                                const uint32_t                   version,
+                                const Ordering                   messageOrder,
+                                MessageFormatterMap&             messageFormatters)
+    {
+        const auto timestampSize = calibration.source != Timestamps::Disabled ? sizeof(uint64_t) : 0;
+
+        // Start each stream at its first block. Lines are prefixed with the stream index.
+        auto                      blocks = collectBlocks(data, version);
+        std::vector<StreamCursor> cursors(blocks.size());
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            if (blocks[i].empty()) continue;
+
+            std::ostringstream prefix;
+            streamFormatter(prefix, i);
+            cursors[i].blocks    = std::move(blocks[i]);
+            cursors[i].remaining = cursors[i].blocks.front();
+            cursors[i].state     = FormatState(regionIndent, regionIndentCharacter, prefix.str());
+        }
+
+        // Merge streams. Each entry is the sort key of the next message of a stream and the stream index, so that ties
+        // are broken by stream index. Streams without messages left are ordered last, so that their remaining records
+        // are written at the end. With timestamp ordering, the message index is the position in the merged output.
+        using entry_t = std::pair<uint64_t, size_t>;
+        std::priority_queue<entry_t, std::vector<entry_t>, std::greater<>> queue;
+        for (size_t i = 0; i < cursors.size(); i++)
+            if (cursors[i].next()) queue.emplace(cursors[i].nextKey(messageOrder, timestampSize), i);
+
+        auto         file  = std::ofstream(mergedFilenameFormatter(path));
+        OutputBuffer out;
+        uint64_t     index = 0;
+        while (!queue.empty())
+        {
+            const auto [sortKey, stream] = queue.top();
+            queue.pop();
+
+            // Write all records up to and including the next message.
+            auto& cursor = cursors[stream];
+            cursor.last  = sortKey;
+            while (cursor.next())
+            {
+                const auto* begin = cursor.remaining.data();
+                MessageKey  key;
+                std::ignore     = read(begin, key);
+                const auto* end = writeRecord(begin, messageOrder, messageFormatters, out, cursor.state, index);
+                cursor.remaining =
+                  cursor.remaining.subspan(std::min(static_cast<size_t>(end - begin), cursor.remaining.size()));
+                if (isMessage(key))
+                {
+                    index++;
+                    break;
+                }
+            }
+
+            if (cursor.next()) queue.emplace(cursor.nextKey(messageOrder, timestampSize), stream);
+            if (out.size() >= mergedFlushSize) out.writeTo(file);
+        }
 
-            // Output file and format state do not exist yet.
-            if (auto it = outputs.find(streamIndex); it == outputs.end())
+        out.writeTo(file);
+    }
+
+    void Formatter::writeBlock(const std::span<const std::byte>          block,
+                               const size_t                              streamIndex,
+                               const Ordering                            messageOrder,
+                               MessageFormatterMap&                      messageFormatters,
+                               OutputBuffer&                             out,
+                               FormatState&                              state,
+                               const std::vector<std::vector<uint64_t>>& indices) const
+    {
+        const auto* in  = block.data();
+        const auto* end = in + block.size();
+        while (in < end)
+        {
+            // With timestamp ordering, messages take their index from the reconstructed order.
+            uint64_t index = 0;
+            if (messageOrder == Ordering::Timestamp)
             {
-                const auto out_path  = filenameFormatter(path, streamIndex);
-                outputs[streamIndex] = std::make_pair<std::ofstream, FormatState>(
-                  std::ofstream(out_path), FormatState(regionIndent, regionIndentCharacter));
+                MessageKey key;
+                std::ignore = read(in, key);
+                if (isMessage(key)) index = indices[streamIndex][state.nextMessage()];
             }
+            in = writeRecord(in, messageOrder, messageFormatters, out, state, index);
+        }
+    }
+
+    const std::byte* Formatter::writeRecord(const std::byte*     in,
+                                            const Ordering       messageOrder,
+                                            MessageFormatterMap& messageFormatters,
+                                            OutputBuffer&        out,
+                                            FormatState&         state,
+                                            const uint64_t       index) const
+    {
+        // Read message key.
+        MessageKey message;
+        in = read(in, message);
+
+        // Format message.
+        switch (message.key)
+        {
+        case MessageTypes::AnonymousRegionStart.key: return writeAnonymousRegionStart(in, out, state);
+        case MessageTypes::NamedRegionStart.key: return writeNamedRegionStart(messageFormatters, in, out, state);
+        case MessageTypes::RegionEnd.key: return writeRegionEnd(in, out, state);
+        case MessageTypes::Dropped.key: return writeDropped(in, out, state);
+        case MessageTypes::Suppressed.key: return writeSuppressed(messageFormatters, in, out, state);
+        default:
+            return writeMessage(messageFormatters, in, out, message, state, messageOrder, index);
+        }
+    }
+
+    std::vector<std::vector<uint64_t>> Formatter::readOrder(const std::span<const std::byte> data,
+                                                            MessageFormatterMap&             messageFormatters) const
+    {
+        const auto version = decodeLogFileHeader(data);
+
+        // Timestamp ordering implies timestamps, which follow every record except dropped records.
+        static constexpr auto timestampSize = sizeof(uint64_t);
+
+        std::vector<std::vector<uint64_t>> timestamps;
+
+        size_t offset = std::min(logFileHeaderSize(version), data.size());
+        while (offset != data.size())
+        {
+            // Read stream index and block size.
+            size_t     streamIndex = 0, blockSize = 0;
+            const auto header      = decodeBlockHeader(data.subspan(offset), version, streamIndex, blockSize);
 
-            // Get output file and format state.
-            std::ofstream& out   = outputs[streamIndex].first;
-            FormatState&   state = outputs[streamIndex].second;
+            // The log of a live or crashed process can end in a partially written or uncommitted block.
+            if (header == 0 || blockSize == 0 || data.size() - offset - header < blockSize) break;
+            if (streamIndex >= timestamps.size()) timestamps.resize(streamIndex + 1);
 
             // Read block.
-            auto end = in.tellg();
-            end += static_cast<std::make_signed_t<size_t>>(blockSize);
-            while (in.tellg() != end)
+            const auto* in  = data.data() + offset + header;
+            const auto* end = in + blockSize;
+            while (in < end)
             {
-                // Read message key.
                 MessageKey message;
-                in.read(reinterpret_cast<char*>(&message), sizeof(MessageKey));
+                in = read(in, message);
 
-                // Format message.
                 switch (message.key)
                 {
-                case MessageTypes::AnonymousRegionStart.key: writeAnonymousRegionStart(out, state); break;
-                case MessageTypes::NamedRegionStart.key:
-                    writeNamedRegionStart(messageFormatters, in, out, state);
+                case MessageTypes::AnonymousRegionStart.key:
+                case MessageTypes::RegionEnd.key: in += timestampSize; break;
+                case MessageTypes::NamedRegionStart.key: in += sizeof(MessageKey) + timestampSize; break;
+                case MessageTypes::Dropped.key: in += sizeof(uint64_t) * 2; break;
+                case MessageTypes::Suppressed.key: in += sizeof(uint64_t) + sizeof(MessageKey); break;
+                default:
+                {
+                    const auto it = messageFormatters.find(message);
+                    if (it == messageFormatters.end())
+                        throw LalError(
+                          std::format("Could not find message {}. Are all its parameters registered?", message.key));
+
+                    uint64_t timestamp = 0;
+                    in                 = read(in, timestamp);
+                    timestamps[streamIndex].push_back(timestamp);
+                    in = it->second->skip(in);
                     break;
-                case MessageTypes::RegionEnd.key: writeRegionEnd(out, state); break;
-                default: writeMessage(messageFormatters, in, out, message, state, messageOrder); break;
+                }
                 }
             }
+
+            offset += header + blockSize;
         }
+
+        return reconstructOrder(timestamps);
     }
 
-    void Formatter::writeAnonymousRegionStart(std::ostream& out, FormatState& state) const
+    const std::byte* Formatter::writeTimestamp(const std::byte* in, OutputBuffer& out) const
     {
-        out << state.getRegionPrepend();
-        anonymousRegionFormatter(out, true);
-        out << "\n";
+        if (calibration.source == Timestamps::Disabled) return in;
+
+        uint64_t ticks = 0;
+        in             = read(in, ticks);
+        callFormatter<TimestampFormatter>(timestampFormatter, out, calibration.toNanoseconds(ticks));
+        return in;
+    }
+
+    const std::byte*
+      Formatter::writeAnonymousRegionStart(const std::byte* in, OutputBuffer& out, FormatState& state) const
+    {
+        out.append(state.getRegionPrepend());
+        in = writeTimestamp(in, out);
+        anonymousRegionFormatter(out.stream(), true);
+        out.append('\n');
         state.pushRegion("");
+        return in;
     }
 
-    void Formatter::writeNamedRegionStart(MessageFormatterMap& messageFormatters,
-                                          std::istream&        in,
-                                          std::ostream&        out,
-                                          FormatState&         state) const
+    const std::byte* Formatter::writeNamedRegionStart(MessageFormatterMap& messageFormatters,
+                                                      const std::byte*     in,
+                                                      OutputBuffer&        out,
+                                                      FormatState&         state) const
     {
         MessageKey key;
-        in.read(reinterpret_cast<char*>(&key), sizeof(MessageKey));
+        in            = read(in, key);
         const auto it = messageFormatters.find(key);
         if (it == messageFormatters.end()) throw LalError(std::format("Could not find named region {}.", key.key));
 
         const auto& format = it->second;
-        out << state.getRegionPrepend();
-        namedRegionFormatter(out, true, format->getMessage());
-        out << "\n";
+        out.append(state.getRegionPrepend());
+        in = writeTimestamp(in, out);
+        namedRegionFormatter(out.stream(), true, format->getMessage());
+        out.append('\n');
         state.pushRegion(format->getMessage());
+        return in;
     }
 
-    void Formatter::writeRegionEnd(std::ostream& out, FormatState& state) const
+    const std::byte* Formatter::writeRegionEnd(const std::byte* in, OutputBuffer& out, FormatState& state) const
     {
+        // The start of the region can be missing from a flight recorder dump.
+        if (!state.hasRegion()) return calibration.source != Timestamps::Disabled ? in + sizeof(uint64_t) : in;
+
         const auto name = state.popRegion();
-        out << state.getRegionPrepend();
+        out.append(state.getRegionPrepend());
+        in = writeTimestamp(in, out);
         if (name.empty())
-            anonymousRegionFormatter(out, false);
+            anonymousRegionFormatter(out.stream(), false);
         else
-            namedRegionFormatter(out, false, name);
-        out << "\n";
+            namedRegionFormatter(out.stream(), false, name);
+        out.append('\n');
+        return in;
     }
 
-    void Formatter::writeSourceInfo(MessageFormatterMap& messageFormatters, std::istream& in, std::ostream& out)
+    const std::byte* Formatter::writeDropped(const std::byte* in, OutputBuffer& out, FormatState& state) const
+    {
+        uint64_t messages = 0, bytes = 0;
+        in = read(in, messages);
+        in = read(in, bytes);
+
+        out.append(state.getRegionPrepend());
+        droppedFormatter(out.stream(), messages, bytes);
+        out.append('\n');
+        return in;
+    }
+
+    const std::byte* Formatter::writeSuppressed(MessageFormatterMap& messageFormatters,
+                                                const std::byte*     in,
+                                                OutputBuffer&        out,
+                                                FormatState&         state) const
+    {
+        uint64_t   messages = 0;
+        MessageKey key;
+        in = read(in, messages);
+        in = read(in, key);
+
+        const auto it = messageFormatters.find(key);
+        if (it == messageFormatters.end())
+            throw LalError(std::format("Could not find message {}. Are all its parameters registered?", key.key));
+
+        out.append(state.getRegionPrepend());
+        suppressedFormatter(out.stream(), messages, it->second->getMessage());
+        out.append('\n');
+        return in;
+    }
+
+    const std::byte*
+      Formatter::writeSourceInfo(MessageFormatterMap& messageFormatters, const std::byte* in, OutputBuffer& out)
     {
         MessageKey key;
-        in.read(reinterpret_cast<char*>(&key), sizeof(MessageKey));
+        in = read(in, key);
 
         const auto it = messageFormatters.find(key);
         if (it == messageFormatters.end())
             throw LalError(std::format("Could not find source information {}.", key.key));
         const auto& formatter = it->second;
-        out << formatter->getMessage() << "\n";
+        out.append(formatter->getMessage());
+        out.append('\n');
+        return in;
     }
 
-    void Formatter::writeMessage(MessageFormatterMap& messageFormatters,
-                                 std::istream&        in,
-                                 std::ostream&        out,
-                                 const MessageKey     key,
-                                 FormatState&         state,
-                                 const bool           order) const
+    const std::byte* Formatter::writeMessage(MessageFormatterMap& messageFormatters,
+                                             const std::byte*     in,
+                                             OutputBuffer&        out,
+                                             const MessageKey     key,
+                                             FormatState&         state,
+                                             const Ordering       order,
+                                             const uint64_t       index) const
     {
         const auto it = messageFormatters.find(key);
-        if (it == messageFormatters.end()) throw LalError(std::format("Could not find message {}.", key.key));
+        if (it == messageFormatters.end())
+            throw LalError(std::format("Could not find message {}. Are all its parameters registered?", key.key));
 
-        out << state.getRegionPrepend();
+        out.append(state.getRegionPrepend());
 
-        if (order)
+        if (order == Ordering::Enabled)
         {
-            uint64_t index = 0;
-            in.read(reinterpret_cast<char*>(&index), sizeof(uint64_t));
-            indexFormatter(out, index);
+            uint64_t storedIndex = 0;
+            in                   = read(in, storedIndex);
+            callFormatter<IndexFormatter>(indexFormatter, out, storedIndex);
         }
+        else if (order == Ordering::Timestamp)
+            callFormatter<IndexFormatter>(indexFormatter, out, index);
+
+        in = writeTimestamp(in, out);
 
         const auto& formatter = it->second;
-        categoryFormatter(out, formatter->getCategory());
-        formatter->format(in, out);
-        out << "\n";
+        callFormatter<CategoryFormatter>(categoryFormatter, out, formatter->getCategory());
+        in = formatter->format(in, out);
+        out.append('\n');
+        return in;
     }
 }  // namespace lal
@@ -62,12 +62,19 @@ namespace lal
     // Format.
     ////////////////////////////////////////////////////////////////
 
-    void MessageFormatter::format(std::istream& in, std::ostream& out) const
+    const std::byte* MessageFormatter::format(const std::byte* in, OutputBuffer& out) const
     {
         for (size_t i = 0; i < std::max(substrings.size(), formatters.size()); i++)
         {
-            out << substrings[i];
-            if (i < formatters.size()) formatters[i]->format(in, out);
+            out.append(substrings[i]);
+            if (i < formatters.size()) in = formatters[i]->format(in, out);
         }
+        return in;
+    }
+
+    const std::byte* MessageFormatter::skip(const std::byte* in) const
+    {
+        for (const auto* f : formatters) in = f->skip(in);
+        return in;
     }
 }  // namespace lal
@@ -0,0 +1,91 @@
+#include "logandload/format/output_buffer.h"
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstring>
+
+namespace lal
+{
+    ////////////////////////////////////////////////////////////////
+    // Constructors.
+    ////////////////////////////////////////////////////////////////
+
+    OutputBuffer::OutputBuffer() : out(this) {}
+
+    OutputBuffer::~OutputBuffer() noexcept = default;
+
+    ////////////////////////////////////////////////////////////////
+    // Getters.
+    ////////////////////////////////////////////////////////////////
+
+    std::ostream& OutputBuffer::stream() noexcept { return out; }
+
+    size_t OutputBuffer::size() const noexcept { return static_cast<size_t>(pptr() - pbase()); }
+
+    ////////////////////////////////////////////////////////////////
+    // Append.
+    ////////////////////////////////////////////////////////////////
+
+    void OutputBuffer::append(const char c)
+    {
+        *reserve(1) = c;
+        pbump(1);
+    }
+
+    void OutputBuffer::append(const std::string_view str)
+    {
+        if (str.empty()) return;
+        std::memcpy(reserve(str.size()), str.data(), str.size());
+        pbump(static_cast<int>(str.size()));
+    }
+
+    void OutputBuffer::appendPadded(const uint64_t value, const size_t width, const char fill)
+    {
+        char       digits[20];
+        const auto size = static_cast<size_t>(std::to_chars(digits, digits + sizeof digits, value).ptr - digits);
+        const auto pad  = width > size ? width - size : 0;
+        char*      ptr  = reserve(pad + size);
+        std::memset(ptr, fill, pad);
+        std::memcpy(ptr + pad, digits, size);
+        pbump(static_cast<int>(pad + size));
+    }
+
+    ////////////////////////////////////////////////////////////////
+    // Output.
+    ////////////////////////////////////////////////////////////////
+
+    void OutputBuffer::writeTo(std::ostream& target)
+    {
+        target.write(pbase(), pptr() - pbase());
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+
+    auto OutputBuffer::overflow(const int_type ch) -> int_type
+    {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) return traits_type::not_eof(ch);
+        append(traits_type::to_char_type(ch));
+        return ch;
+    }
+
+    std::streamsize OutputBuffer::xsputn(const char* s, const std::streamsize count)
+    {
+        append(std::string_view(s, static_cast<size_t>(count)));
+        return count;
+    }
+
+    char* OutputBuffer::reserve(const size_t count)
+    {
+        if (static_cast<size_t>(epptr() - pptr()) < count)
+        {
+            // Grow geometrically and restore the current position in the new storage.
+            const auto offset = static_cast<size_t>(pptr() - pbase());
+            buffer.resize(std::max({buffer.size() * 2, offset + count, static_cast<size_t>(4096)}));
+            setp(buffer.data(), buffer.data() + buffer.size());
+            pbump(static_cast<int>(offset));
+        }
+        return pptr();
+    }
+}  // namespace lal
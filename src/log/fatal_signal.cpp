@@ -0,0 +1,141 @@
+#include "logandload/log/fatal_signal.h"
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <mutex>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+////////////////////////////////////////////////////////////////
+// Current target includes.
+////////////////////////////////////////////////////////////////
+
+#include "logandload/utils/lal_error.h"
+
+namespace
+{
+    struct Slot
+    {
+        std::atomic<lal::FatalSignalCallback> callback = nullptr;
+        std::atomic<void*>                    context  = nullptr;
+    };
+
+    std::array<Slot, lal::maxFatalSignalCallbacks> slots;
+
+    /**
+     * \brief Protects adding and removing callbacks and installing handlers. Never locked by the handler.
+     */
+    std::mutex mutex;
+
+#ifndef WIN32
+    constexpr std::array signals = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+
+    std::array<struct sigaction, signals.size()> previous;
+
+    bool installed = false;
+
+    void handleSignal(const int signal)
+    {
+        // Only run callbacks once, even if a callback crashes or several threads crash at the same time.
+        static std::atomic_flag handling;
+        if (!handling.test_and_set())
+        {
+            for (auto& slot : slots)
+                if (auto* callback = slot.callback.load(std::memory_order_acquire); callback)
+                    callback(slot.context.load(std::memory_order_relaxed));
+        }
+
+        // Restore previous handler and raise signal again once this handler returns.
+        for (size_t i = 0; i < signals.size(); i++)
+            if (signals[i] == signal) sigaction(signal, &previous[i], nullptr);
+        raise(signal);
+    }
+#endif
+}  // namespace
+
+namespace lal
+{
+    size_t addFatalSignalCallback(const FatalSignalCallback callback, void* context)
+    {
+        std::scoped_lock lock(mutex);
+
+#ifndef WIN32
+        if (!installed)
+        {
+            struct sigaction action = {};
+            action.sa_handler       = handleSignal;
+            action.sa_flags         = SA_NODEFER;
+            sigemptyset(&action.sa_mask);
+            for (size_t i = 0; i < signals.size(); i++) sigaction(signals[i], &action, &previous[i]);
+            installed = true;
+        }
+#endif
+
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            if (slots[i].callback.load(std::memory_order_relaxed)) continue;
+
+            // Context must be visible before the callback.
+            slots[i].context.store(context, std::memory_order_relaxed);
+            slots[i].callback.store(callback, std::memory_order_release);
+            return i;
+        }
+
+        throw LalError("Too many fatal signal callbacks.");
+    }
+
+    void removeFatalSignalCallback(const size_t handle) noexcept
+    {
+        std::scoped_lock lock(mutex);
+        slots[handle].callback.store(nullptr, std::memory_order_release);
+    }
+
+    int openFileSignalSafe([[maybe_unused]] const std::filesystem::path::value_type* path,
+                           [[maybe_unused]] const bool                               truncate) noexcept
+    {
+#ifdef WIN32
+        return -1;
+#else
+        return ::open(path, O_WRONLY | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0644);
+#endif
+    }
+
+    bool writeFileSignalSafe([[maybe_unused]] const int   fd,
+                             [[maybe_unused]] const void* data,
+                             [[maybe_unused]] size_t      size) noexcept
+    {
+#ifdef WIN32
+        return false;
+#else
+        const auto* bytes = static_cast<const std::byte*>(data);
+        while (size > 0)
+        {
+            const auto written = ::write(fd, bytes, size);
+            if (written < 0)
+            {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            bytes += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+#endif
+    }
+
+    void closeFileSignalSafe([[maybe_unused]] const int fd) noexcept
+    {
+#ifndef WIN32
+        ::close(fd);
+#endif
+    }
+}  // namespace lal
@@ -0,0 +1,63 @@
+#include "logandload/log/format_file.h"
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <format>
+
+////////////////////////////////////////////////////////////////
+// Current target includes.
+////////////////////////////////////////////////////////////////
+
+#include "logandload/utils/lal_error.h"
+
+namespace lal
+{
+    FormatFileSettings readFormatFileSettings(std::istream& in)
+    {
+        const auto       start = in.tellg();
+        FormatFileHeader header{.magic = 0};
+        in.read(reinterpret_cast<char*>(&header), sizeof header);
+
+        // Without file header, the settings start right away.
+        FormatFileSettings settings;
+        settings.version = 1;
+        if (in && header.magic == FormatFileHeader::currentMagic)
+        {
+            if (header.version < 2 || header.version > FormatFileHeader::currentVersion)
+                throw LalError(std::format("Unsupported format file version {}.", header.version));
+            settings.version = header.version;
+        }
+        in.clear();
+        in.seekg(start + static_cast<std::streamoff>(formatFileHeaderSize(settings.version)));
+
+        // Read number of streams and message order setting.
+        in.read(reinterpret_cast<char*>(&settings.streamCount), sizeof settings.streamCount);
+        uint8_t order = 0;
+        in.read(reinterpret_cast<char*>(&order), sizeof order);
+        settings.order = static_cast<Ordering>(order);
+        if (settings.version == 1)
+        {
+            if (!in) throw LalError("Format file header is truncated.");
+            if (settings.order != Ordering::Disabled && settings.order != Ordering::Enabled)
+                throw LalError(std::format("Unsupported message order setting {} in format file.", order));
+            return settings;
+        }
+
+        // Read timestamp source and calibration.
+        uint8_t source = 0;
+        in.read(reinterpret_cast<char*>(&source), sizeof source);
+        settings.calibration.source = static_cast<Timestamps>(source);
+        if (settings.calibration.source != Timestamps::Disabled)
+        {
+            auto& calibration = settings.calibration;
+            in.read(reinterpret_cast<char*>(&calibration.ticksPerNs), sizeof calibration.ticksPerNs);
+            in.read(reinterpret_cast<char*>(&calibration.anchorTicks), sizeof calibration.anchorTicks);
+            in.read(reinterpret_cast<char*>(&calibration.anchorNs), sizeof calibration.anchorNs);
+        }
+
+        if (!in) throw LalError("Format file header is truncated.");
+        return settings;
+    }
+}  // namespace lal
@@ -0,0 +1,123 @@
+#include "logandload/log/log_file.h"
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+
+////////////////////////////////////////////////////////////////
+// Current target includes.
+////////////////////////////////////////////////////////////////
+
+#include "logandload/utils/lal_error.h"
+
+namespace
+{
+    /**
+     * \brief Decode an unsigned LEB128 varint.
+     * \param data Data starting at the varint.
+     * \param value Value.
+     * \return Size of the varint, or 0 if data ends within it or it does not fit into a size_t.
+     */
+    size_t decodeVarint(const std::span<const std::byte> data, size_t& value) noexcept
+    {
+        value = 0;
+        for (size_t i = 0; i < data.size() && i * 7 < sizeof(size_t) * 8; i++)
+        {
+            const auto byte = std::to_integer<size_t>(data[i]);
+            value |= (byte & 0x7f) << (i * 7);
+            if ((byte & 0x80) == 0) return i + 1;
+        }
+        return 0;
+    }
+
+    /**
+     * \brief Read an unsigned LEB128 varint.
+     * \param in Stream.
+     * \param value Value.
+     * \return True on success.
+     */
+    bool readVarint(std::istream& in, size_t& value)
+    {
+        value = 0;
+        for (size_t shift = 0; shift < sizeof(size_t) * 8; shift += 7)
+        {
+            const auto byte = in.get();
+            if (byte == std::istream::traits_type::eof()) return false;
+            value |= static_cast<size_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) return true;
+        }
+        return false;
+    }
+
+    /**
+     * \brief Get the version from a file header.
+     * \param header Candidate file header.
+     * \return Version. 1 if this is not a file header.
+     */
+    uint32_t getVersion(const lal::LogFileHeader& header)
+    {
+        if (header.magic != lal::LogFileHeader::currentMagic) return 1;
+        if (header.version < 2 || header.version > lal::LogFileHeader::currentVersion)
+            throw lal::LalError(std::format("Unsupported log file version {}.", header.version));
+        return header.version;
+    }
+}  // namespace
+
+namespace lal
+{
+    uint32_t decodeLogFileHeader(const std::span<const std::byte> data)
+    {
+        LogFileHeader header{.magic = 0};
+        if (!data.empty()) std::memcpy(&header, data.data(), std::min(data.size(), sizeof header));
+        return getVersion(header);
+    }
+
+    uint32_t readLogFileHeader(std::istream& in)
+    {
+        const auto    start = in.tellg();
+        LogFileHeader header{.magic = 0};
+        in.read(reinterpret_cast<char*>(&header), sizeof header);
+
+        // Without file header, the first block starts right away.
+        in.clear();
+        const auto version = getVersion(header);
+        in.seekg(start + static_cast<std::streamoff>(logFileHeaderSize(version)));
+        return version;
+    }
+
+    size_t decodeBlockHeader(const std::span<const std::byte> data,
+                             const uint32_t                   version,
+                             size_t&                          index,
+                             size_t&                          size) noexcept
+    {
+        if (version == 1)
+        {
+            if (data.size() < sizeof(size_t) * 2) return 0;
+            std::memcpy(&index, data.data(), sizeof index);
+            std::memcpy(&size, data.data() + sizeof index, sizeof size);
+            return sizeof(size_t) * 2;
+        }
+
+        const auto indexSize = decodeVarint(data, index);
+        if (indexSize == 0) return 0;
+        const auto sizeSize = decodeVarint(data.subspan(indexSize), size);
+        if (sizeSize == 0) return 0;
+        return indexSize + sizeSize;
+    }
+
+    bool readBlockHeader(std::istream& in, const uint32_t version, size_t& index, size_t& size)
+    {
+        if (version == 1)
+        {
+            in.read(reinterpret_cast<char*>(&index), sizeof index);
+            in.read(reinterpret_cast<char*>(&size), sizeof size);
+            return static_cast<bool>(in);
+        }
+
+        return readVarint(in, index) && readVarint(in, size);
+    }
+}  // namespace lal
@@ -0,0 +1,90 @@
+#include "logandload/log/mapped_file.h"
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace lal
+{
+#ifndef WIN32
+
+    ////////////////////////////////////////////////////////////////
+    // Constructors.
+    ////////////////////////////////////////////////////////////////
+
+    MappedFile::MappedFile(const std::filesystem::path& path)
+    {
+        // Mappings require read access, even if they are only written to.
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+
+    MappedFile::~MappedFile() noexcept
+    {
+        if (fd >= 0) ::close(fd);
+    }
+
+    ////////////////////////////////////////////////////////////////
+    // Getters.
+    ////////////////////////////////////////////////////////////////
+
+    bool MappedFile::good() const noexcept { return fd >= 0; }
+
+    size_t MappedFile::granularity() noexcept { return static_cast<size_t>(::sysconf(_SC_PAGESIZE)); }
+
+    ////////////////////////////////////////////////////////////////
+    // Mapping.
+    ////////////////////////////////////////////////////////////////
+
+    uint8_t* MappedFile::map(const uint64_t offset, const size_t size)
+    {
+        if (::ftruncate(fd, static_cast<off_t>(offset + size)) != 0) return nullptr;
+
+        auto* data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(offset));
+        if (data == MAP_FAILED) return nullptr;
+
+        return static_cast<uint8_t*>(data);
+    }
+
+    void MappedFile::unmap(uint8_t* data, const size_t size)
+    {
+        ::msync(data, size, MS_ASYNC);
+        ::madvise(data, size, MADV_DONTNEED);
+        ::munmap(data, size);
+    }
+
+    void MappedFile::write(const uint64_t offset, const void* data, const size_t size)
+    {
+        [[maybe_unused]] const auto res = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+    }
+
+    void MappedFile::truncate(const uint64_t size)
+    {
+        [[maybe_unused]] const auto res = ::ftruncate(fd, static_cast<off_t>(size));
+    }
+
+#else
+
+    MappedFile::MappedFile(const std::filesystem::path&) {}
+
+    MappedFile::~MappedFile() noexcept = default;
+
+    bool MappedFile::good() const noexcept { return false; }
+
+    size_t MappedFile::granularity() noexcept { return 1; }
+
+    uint8_t* MappedFile::map(uint64_t, size_t) { return nullptr; }
+
+    void MappedFile::unmap(uint8_t*, size_t) {}
+
+    void MappedFile::write(uint64_t, const void*, size_t) {}
+
+    void MappedFile::truncate(uint64_t) {}
+
+#endif
+}  // namespace lal
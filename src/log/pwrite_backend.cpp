@@ -0,0 +1,144 @@
+#include "logandload/log/pwrite_backend.h"
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+
+#ifndef WIN32
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace lal
+{
+#ifndef WIN32
+    static_assert(sizeof(WriteSegment) == sizeof(iovec));
+    static_assert(offsetof(WriteSegment, data) == offsetof(iovec, iov_base));
+    static_assert(offsetof(WriteSegment, size) == offsetof(iovec, iov_len));
+#endif
+
+    ////////////////////////////////////////////////////////////////
+    // Constructors.
+    ////////////////////////////////////////////////////////////////
+
+    PwriteBackend::PwriteBackend(const std::filesystem::path& path, [[maybe_unused]] const bool direct)
+    {
+#ifdef WIN32
+        // Direct I/O is not supported by std::ofstream, writes go through the cache.
+        stream = std::ofstream(path, std::ios::binary);
+        ok     = stream.good();
+#else
+        fd = openLogFile(path, direct);
+        ok = fd >= 0;
+#endif
+    }
+
+    PwriteBackend::~PwriteBackend() noexcept
+    {
+#ifndef WIN32
+        if (fd >= 0) ::close(fd);
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////
+    // Getters.
+    ////////////////////////////////////////////////////////////////
+
+    bool PwriteBackend::good() const noexcept { return ok; }
+
+    size_t PwriteBackend::pending() const noexcept { return completed.size(); }
+
+    ////////////////////////////////////////////////////////////////
+    // Writing.
+    ////////////////////////////////////////////////////////////////
+
+    void PwriteBackend::submit(uint64_t offset, const void* data, const size_t size, const size_t tag)
+    {
+        completed.push_back(tag);
+        if (!ok) return;
+
+#ifdef WIN32
+        stream.seekp(static_cast<std::streamoff>(offset));
+        stream.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        ok = stream.good();
+#else
+        const auto* first = static_cast<const std::byte*>(data);
+        const auto* last  = first + size;
+        while (first < last)
+        {
+            const auto written =
+              ::pwrite(fd, first, static_cast<size_t>(last - first), static_cast<off_t>(offset));
+            if (written < 0)
+            {
+                if (errno == EINTR) continue;
+                ok = false;
+                return;
+            }
+            first += written;
+            offset += static_cast<uint64_t>(written);
+        }
+#endif
+    }
+
+    void PwriteBackend::submit(uint64_t offset, const std::span<WriteSegment> segments, const size_t tag)
+    {
+        completed.push_back(tag);
+        if (!ok) return;
+
+#ifdef WIN32
+        stream.seekp(static_cast<std::streamoff>(offset));
+        for (const auto& s : segments)
+            stream.write(static_cast<const char*>(s.data), static_cast<std::streamsize>(s.size));
+        ok = stream.good();
+#else
+        auto* first = reinterpret_cast<iovec*>(segments.data());
+        auto* last  = first + segments.size();
+        while (first < last)
+        {
+            const auto count   = static_cast<int>(std::min<std::ptrdiff_t>(last - first, IOV_MAX));
+            auto       written = ::pwritev(fd, first, count, static_cast<off_t>(offset));
+            if (written < 0)
+            {
+                if (errno == EINTR) continue;
+                ok = false;
+                return;
+            }
+            offset += static_cast<uint64_t>(written);
+
+            // Skip fully written segments and adjust partially written segment.
+            while (first < last && static_cast<size_t>(written) >= first->iov_len)
+            {
+                written -= static_cast<ssize_t>(first->iov_len);
+                ++first;
+            }
+            if (first < last)
+            {
+                first->iov_base = static_cast<std::byte*>(first->iov_base) + written;
+                first->iov_len -= static_cast<size_t>(written);
+            }
+        }
+#endif
+    }
+
+    size_t PwriteBackend::wait()
+    {
+        assert(!completed.empty());
+        const auto tag = completed.front();
+        completed.pop_front();
+        return tag;
+    }
+
+    std::optional<size_t> PwriteBackend::poll()
+    {
+        // Writes complete during submit.
+        if (completed.empty()) return std::nullopt;
+        return wait();
+    }
+}  // namespace lal
@@ -0,0 +1,271 @@
+#include "logandload/log/recovery.h"
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <memory>
+
+////////////////////////////////////////////////////////////////
+// Current target includes.
+////////////////////////////////////////////////////////////////
+
+#include "logandload/log/format_file.h"
+#include "logandload/log/log_file.h"
+#include "logandload/utils/lal_error.h"
+
+namespace
+{
+    /**
+     * \brief Header at the start of a recovery file.
+     */
+    struct RecoveryHeader
+    {
+        static constexpr uint64_t currentMagic   = 0x31564345524c414c;  // "LALRECV1"
+        static constexpr uint32_t currentVersion = 1;
+
+        uint64_t magic     = currentMagic;
+        uint32_t version   = currentVersion;
+        uint32_t buffering = 0;
+
+        /**
+         * \brief File offset of the first stream region.
+         */
+        uint64_t streamsOffset = 0;
+
+        /**
+         * \brief Number of stream regions. Incremented once a region is initialized.
+         */
+        std::atomic_uint64_t streamCount = 0;
+    };
+
+    /**
+     * \brief Read a trivially copyable value from a byte buffer.
+     * \tparam T Value type.
+     * \param data Buffer.
+     * \param offset Offset in buffer.
+     * \return Value.
+     */
+    template<typename T>
+    T readValue(const std::vector<uint8_t>& data, const size_t offset)
+    {
+        if (offset + sizeof(T) > data.size()) throw lal::LalError("Recovery file is truncated.");
+
+        T value;
+        std::memcpy(&value, data.data() + offset, sizeof(T));
+        return value;
+    }
+}  // namespace
+
+namespace lal
+{
+    ////////////////////////////////////////////////////////////////
+    // Constructors.
+    ////////////////////////////////////////////////////////////////
+
+    RecoveryFile::RecoveryFile(const std::filesystem::path& path, const Buffering buffering) : file(path)
+    {
+        if (!file.good()) return;
+
+        // Header gets a chunk of its own, so that stream regions can be mapped separately.
+        offset = MappedFile::granularity();
+        header = file.map(0, offset);
+        if (!header) return;
+
+        auto* h          = std::construct_at(reinterpret_cast<RecoveryHeader*>(header));
+        h->buffering     = static_cast<uint32_t>(buffering);
+        h->streamsOffset = offset;
+    }
+
+    RecoveryFile::~RecoveryFile() noexcept
+    {
+        for (const auto& [data, size] : regions) file.unmap(data, size);
+        if (header) file.unmap(header, MappedFile::granularity());
+    }
+
+    ////////////////////////////////////////////////////////////////
+    // Getters.
+    ////////////////////////////////////////////////////////////////
+
+    bool RecoveryFile::good() const noexcept { return header != nullptr; }
+
+    ////////////////////////////////////////////////////////////////
+    // Streams.
+    ////////////////////////////////////////////////////////////////
+
+    RecoveryStream* RecoveryFile::addStream(const size_t index, const size_t size, const size_t count)
+    {
+        const auto granularity = MappedFile::granularity();
+        const auto regionSize  = (RecoveryStream::headerSize + count * ((size + 63) / 64 * 64) + granularity - 1) /
+                                granularity * granularity;
+
+        auto* data = file.map(offset, regionSize);
+        if (!data) return nullptr;
+        regions.emplace_back(data, regionSize);
+        offset += regionSize;
+
+        auto* stream       = std::construct_at(reinterpret_cast<RecoveryStream*>(data));
+        stream->index      = index;
+        stream->size       = size;
+        stream->count      = count;
+        stream->regionSize = regionSize;
+
+        // Region is complete, make it visible to recovery.
+        reinterpret_cast<RecoveryHeader*>(header)->streamCount.fetch_add(1, std::memory_order_release);
+
+        return stream;
+    }
+
+    ////////////////////////////////////////////////////////////////
+    // Recovery.
+    ////////////////////////////////////////////////////////////////
+
+    uint64_t recoverLog(const std::filesystem::path& path)
+    {
+        auto recPath = path;
+        recPath += ".rec";
+        auto fmtPath = path;
+        fmtPath += ".fmt";
+
+        // Read recovery file.
+        std::vector<uint8_t> rec;
+        {
+            auto file = std::ifstream(recPath, std::ios::binary | std::ios::ate);
+            if (!file) throw LalError(std::format("Failed to open recovery file {}.", recPath.string()));
+            rec.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(rec.data()), static_cast<std::streamsize>(rec.size()));
+        }
+
+        if (readValue<uint64_t>(rec, offsetof(RecoveryHeader, magic)) != RecoveryHeader::currentMagic ||
+            readValue<uint32_t>(rec, offsetof(RecoveryHeader, version)) != RecoveryHeader::currentVersion)
+            throw LalError(std::format("{} is not a recovery file.", recPath.string()));
+        const auto buffering   = readValue<uint32_t>(rec, offsetof(RecoveryHeader, buffering));
+        const auto streamCount = readValue<uint64_t>(rec, offsetof(RecoveryHeader, streamCount));
+        auto       offset      = readValue<uint64_t>(rec, offsetof(RecoveryHeader, streamsOffset));
+
+        // Find the end of the committed blocks in the log file and the stream position up to which each stream's data
+        // is in there. A block that was torn by the crash has size 0.
+        std::vector<uint64_t> positions(streamCount);
+        uint64_t              complete = 0;
+        uint32_t              version  = 0;
+        {
+            auto file = std::ifstream(path, std::ios::binary | std::ios::ate);
+            if (!file) throw LalError(std::format("Failed to open log file {}.", path.string()));
+            const auto length = static_cast<uint64_t>(file.tellg());
+            file.seekg(0);
+
+            // The file header is written when the log is created, so it is always there.
+            version  = length >= sizeof(LogFileHeader) ? readLogFileHeader(file) : 1;
+            complete = static_cast<uint64_t>(file.tellg());
+
+            while (complete < length)
+            {
+                size_t streamIndex = 0, blockSize = 0;
+                if (!readBlockHeader(file, version, streamIndex, blockSize)) break;
+                const auto headerSize = static_cast<uint64_t>(file.tellg()) - complete;
+                if (blockSize == 0 || blockSize > length - complete - headerSize) break;
+
+                if (streamIndex < streamCount) positions[streamIndex] += blockSize;
+                complete += headerSize + blockSize;
+                file.seekg(static_cast<std::streamoff>(complete));
+            }
+        }
+        std::filesystem::resize_file(path, complete);
+
+        // Append the data of each stream that did not make it to the log file, as one block per contiguous range.
+        auto out = std::ofstream(path, std::ios::binary | std::ios::app);
+        if (!out) throw LalError(std::format("Failed to open log file {}.", path.string()));
+
+        // Blocks are appended in the format of the existing log.
+        const auto writeHeader = [&out, version](const uint64_t index, const uint64_t size) {
+            if (version == 1)
+            {
+                const std::array<size_t, 2> header{index, size};
+                out.write(reinterpret_cast<const char*>(header.data()), sizeof header);
+                return;
+            }
+
+            std::array<uint8_t, maxBlockHeaderSize> header;
+            out.write(reinterpret_cast<const char*>(header.data()),
+                      static_cast<std::streamsize>(encodeBlockHeader(index, size, header.data())));
+        };
+
+        const auto writeBlock = [&out, &writeHeader](const uint64_t index, const uint8_t* data, const uint64_t size) {
+            writeHeader(index, size);
+            out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+        };
+
+        uint64_t recovered = 0;
+        for (uint64_t i = 0; i < streamCount; i++)
+        {
+            const auto regionSize = readValue<uint64_t>(rec, offset + offsetof(RecoveryStream, regionSize));
+            if (offset + regionSize > rec.size()) throw LalError("Recovery file is truncated.");
+
+            auto&      stream   = *reinterpret_cast<RecoveryStream*>(rec.data() + offset);
+            const auto index    = stream.index;
+            const auto size     = stream.size;
+            auto&      position = positions[i];
+
+            if (buffering == static_cast<uint32_t>(Buffering::Double))
+            {
+                // Front and back buffer hold consecutive ranges of the stream. Take them in order.
+                std::array<std::pair<uint64_t, size_t>, 2> buffers{
+                  {{stream.start[0].load(), 0}, {stream.start[1].load(), 1}}};
+                std::ranges::sort(buffers);
+                for (const auto& [start, b] : buffers)
+                {
+                    const auto end   = start + std::min<uint64_t>(stream.used[b].load(), size);
+                    const auto first = std::max(start, position);
+                    if (first >= end) continue;
+
+                    writeBlock(index, stream.data(b) + (first - start), end - first);
+                    recovered += end - first;
+                    position = end;
+                }
+            }
+            else
+            {
+                // Everything in the ring from the log's position up to the last complete record. The ring cannot
+                // have overwritten any of it, since it never gets ahead of the log by more than its size.
+                const auto last  = stream.used[0].load();
+                const auto first = std::max(position, last > size ? last - size : 0);
+                if (first < last)
+                {
+                    const auto begin = first % size;
+                    const auto part0 = std::min(last - first, size - begin);
+                    writeHeader(index, last - first);
+                    out.write(reinterpret_cast<const char*>(stream.data(0) + begin),
+                              static_cast<std::streamsize>(part0));
+                    out.write(reinterpret_cast<const char*>(stream.data(0)),
+                              static_cast<std::streamsize>(last - first - part0));
+                    recovered += last - first;
+                }
+            }
+
+            offset += regionSize;
+        }
+
+        out.close();
+        if (!out) throw LalError(std::format("Failed to write log file {}.", path.string()));
+
+        // Streams that were created shortly before the crash may be missing from the format file header.
+        {
+            auto fmt = std::fstream(fmtPath, std::ios::binary | std::ios::in | std::ios::out);
+            if (!fmt) throw LalError(std::format("Failed to open format file {}.", fmtPath.string()));
+            if (const auto settings = readFormatFileSettings(fmt); settings.streamCount < streamCount)
+            {
+                const auto count = static_cast<size_t>(streamCount);
+                fmt.seekp(static_cast<std::streamoff>(formatFileHeaderSize(settings.version)));
+                fmt.write(reinterpret_cast<const char*>(&count), sizeof count);
+            }
+        }
+
+        std::filesystem::remove(recPath);
+        return recovered;
+    }
+}  // namespace lal
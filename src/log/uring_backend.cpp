@@ -0,0 +1,368 @@
+#include "logandload/log/uring_backend.h"
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <ranges>
+
+#ifdef LOGANDLOAD_IO_URING
+#include <climits>
+#include <fcntl.h>
+#include <liburing.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifdef LOGANDLOAD_IO_URING
+namespace
+{
+    /**
+     * \brief Contiguous writes are not split into requests smaller than this.
+     */
+    constexpr size_t minRequestSize = 64 * 1024;
+}  // namespace
+#endif
+
+namespace lal
+{
+#ifdef LOGANDLOAD_IO_URING
+
+    ////////////////////////////////////////////////////////////////
+    // Constructors.
+    ////////////////////////////////////////////////////////////////
+
+    UringBackend::UringBackend(const std::filesystem::path& path, const uint32_t queueDepth, const bool direct)
+    {
+        const auto depth = std::max<uint32_t>(queueDepth, 1);
+
+        fd = openLogFile(path, direct);
+        if (fd < 0) return;
+
+        ring = new io_uring;
+        if (io_uring_queue_init(depth, ring, 0) < 0)
+        {
+            delete ring;
+            ring = nullptr;
+            return;
+        }
+
+        requests.resize(depth);
+        for (uint32_t i = depth; i > 0; i--) freeRequests.push_back(i - 1);
+
+        ok = true;
+    }
+
+    UringBackend::~UringBackend() noexcept
+    {
+        if (ring)
+        {
+            while (!outstanding.empty()) reap(true);
+            io_uring_queue_exit(ring);
+            delete ring;
+        }
+        if (fd >= 0) ::close(fd);
+    }
+
+    ////////////////////////////////////////////////////////////////
+    // Getters.
+    ////////////////////////////////////////////////////////////////
+
+    bool UringBackend::supported() noexcept { return true; }
+
+    bool UringBackend::good() const noexcept { return ok; }
+
+    size_t UringBackend::pending() const noexcept { return outstanding.size() + completed.size(); }
+
+    ////////////////////////////////////////////////////////////////
+    // Writing.
+    ////////////////////////////////////////////////////////////////
+
+    void UringBackend::registerBuffers(const std::span<const WriteSegment> buffers)
+    {
+        if (!ok) return;
+
+        std::vector<iovec> iov;
+        for (const auto& b : buffers) iov.push_back(iovec{const_cast<void*>(b.data), b.size});
+
+        // Registration can fail, e.g. because of RLIMIT_MEMLOCK. Writes then simply do not use fixed buffers.
+        if (io_uring_register_buffers(ring, iov.data(), static_cast<unsigned>(iov.size())) == 0)
+            registered.assign(buffers.begin(), buffers.end());
+    }
+
+    void UringBackend::submit(uint64_t offset, const void* data, const size_t size, const size_t tag)
+    {
+        if (!ok || size == 0)
+        {
+            completed.push_back(tag);
+            return;
+        }
+
+        // Look for a registered buffer containing the data.
+        const auto* first  = static_cast<const uint8_t*>(data);
+        int32_t     buffer = -1;
+        for (size_t i = 0; i < registered.size(); i++)
+        {
+            const auto* b = static_cast<const uint8_t*>(registered[i].data);
+            if (first >= b && first + size <= b + registered[i].size) buffer = static_cast<int32_t>(i);
+        }
+
+        // Split write over all requests, so that the device can work on them in parallel. Requests are kept
+        // block-aligned, which direct I/O requires.
+        auto requestSize = std::max(minRequestSize, (size + requests.size() - 1) / requests.size());
+        requestSize      = (requestSize + directIoAlignment - 1) / directIoAlignment * directIoAlignment;
+        const auto count       = (size + requestSize - 1) / requestSize;
+        outstanding[tag]       = count;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const auto index = acquire();
+            if (!ok)
+            {
+                // A write failed while waiting for a free request. Drop the rest of this write.
+                freeRequests.push_back(index);
+                complete(tag, count - i);
+                break;
+            }
+
+            auto& r        = requests[index];
+            r.tag          = tag;
+            r.offset       = offset + i * requestSize;
+            r.data         = first + i * requestSize;
+            r.size         = std::min(requestSize, size - i * requestSize);
+            r.buffer       = buffer;
+            r.segments     = nullptr;
+            r.segmentCount = 0;
+            prepare(index);
+        }
+
+        io_uring_submit(ring);
+    }
+
+    void UringBackend::submit(uint64_t offset, const std::span<WriteSegment> segments, const size_t tag)
+    {
+        if (!ok || segments.empty())
+        {
+            completed.push_back(tag);
+            return;
+        }
+
+        // A single writev request is limited to IOV_MAX segments.
+        const auto count = (segments.size() + IOV_MAX - 1) / IOV_MAX;
+        outstanding[tag] = count;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const auto part  = segments.subspan(i * IOV_MAX, std::min<size_t>(IOV_MAX, segments.size() - i * IOV_MAX));
+            const auto index = acquire();
+            if (!ok)
+            {
+                // A write failed while waiting for a free request. Drop the rest of this write.
+                freeRequests.push_back(index);
+                complete(tag, count - i);
+                break;
+            }
+
+            auto& r        = requests[index];
+            r.tag          = tag;
+            r.offset       = offset;
+            r.data         = nullptr;
+            r.size         = 0;
+            r.buffer       = -1;
+            r.segments     = part.data();
+            r.segmentCount = part.size();
+            prepare(index);
+
+            for (const auto& s : part) offset += s.size;
+        }
+
+        io_uring_submit(ring);
+    }
+
+    size_t UringBackend::wait()
+    {
+        assert(pending() > 0);
+
+        while (completed.empty()) reap(true);
+
+        const auto tag = completed.front();
+        completed.pop_front();
+        return tag;
+    }
+
+    std::optional<size_t> UringBackend::poll()
+    {
+        while (completed.empty() && !outstanding.empty() && reap(false)) {}
+        if (completed.empty()) return std::nullopt;
+
+        const auto tag = completed.front();
+        completed.pop_front();
+        return tag;
+    }
+
+    uint32_t UringBackend::acquire()
+    {
+        while (freeRequests.empty()) reap(true);
+
+        const auto index = freeRequests.back();
+        freeRequests.pop_back();
+        return index;
+    }
+
+    void UringBackend::prepare(const uint32_t index)
+    {
+        // There are as many submission queue entries as requests, so this cannot fail.
+        auto* sqe = io_uring_get_sqe(ring);
+        assert(sqe);
+
+        const auto& r = requests[index];
+        if (r.segments)
+            io_uring_prep_writev(
+              sqe, fd, reinterpret_cast<const iovec*>(r.segments), static_cast<unsigned>(r.segmentCount), r.offset);
+        else if (r.buffer >= 0)
+            io_uring_prep_write_fixed(sqe, fd, r.data, static_cast<unsigned>(r.size), r.offset, r.buffer);
+        else
+            io_uring_prep_write(sqe, fd, r.data, static_cast<unsigned>(r.size), r.offset);
+        sqe->user_data = index;
+    }
+
+    bool UringBackend::reap(const bool block)
+    {
+        io_uring_cqe* cqe = nullptr;
+        io_uring_submit(ring);
+        if (const auto ret = block ? io_uring_wait_cqe(ring, &cqe) : io_uring_peek_cqe(ring, &cqe); ret < 0)
+        {
+            if (ret == -EINTR || (ret == -EAGAIN && !block)) return false;
+
+            // Ring is unusable. Complete everything and give up on all requests in flight to prevent callers from
+            // waiting forever.
+            ok = false;
+            for (const auto& tag : outstanding | std::views::keys) completed.push_back(tag);
+            outstanding.clear();
+            freeRequests.clear();
+            for (auto i = static_cast<uint32_t>(requests.size()); i > 0; i--) freeRequests.push_back(i - 1);
+            return true;
+        }
+
+        const auto index = static_cast<uint32_t>(cqe->user_data);
+        const auto res   = cqe->res;
+        io_uring_cqe_seen(ring, cqe);
+
+        auto& r = requests[index];
+        if (res == -EINTR || res == -EAGAIN)
+        {
+            prepare(index);
+            return true;
+        }
+        if (res < 0)
+        {
+            ok = false;
+            finish(index);
+            return true;
+        }
+
+        // Resubmit remainder of a partial write.
+        auto written = static_cast<size_t>(res);
+        r.offset += written;
+        if (r.segments)
+        {
+            while (r.segmentCount > 0 && written >= r.segments->size)
+            {
+                written -= r.segments->size;
+                r.segments++;
+                r.segmentCount--;
+            }
+            if (r.segmentCount > 0)
+            {
+                r.segments->data = static_cast<const uint8_t*>(r.segments->data) + written;
+                r.segments->size -= written;
+                prepare(index);
+                return true;
+            }
+        }
+        else if (written < r.size)
+        {
+            r.data += written;
+            r.size -= written;
+            prepare(index);
+            return true;
+        }
+
+        finish(index);
+        return true;
+    }
+
+    void UringBackend::finish(const uint32_t index)
+    {
+        freeRequests.push_back(index);
+        complete(requests[index].tag, 1);
+    }
+
+    void UringBackend::complete(const size_t tag, const size_t count)
+    {
+        if (const auto it = outstanding.find(tag); it != outstanding.end() && (it->second -= count) == 0)
+        {
+            outstanding.erase(it);
+            completed.push_back(tag);
+        }
+    }
+
+#else
+
+    ////////////////////////////////////////////////////////////////
+    // Constructors.
+    ////////////////////////////////////////////////////////////////
+
+    UringBackend::UringBackend(const std::filesystem::path&, uint32_t, bool) {}
+
+    UringBackend::~UringBackend() noexcept = default;
+
+    ////////////////////////////////////////////////////////////////
+    // Getters.
+    ////////////////////////////////////////////////////////////////
+
+    bool UringBackend::supported() noexcept { return false; }
+
+    bool UringBackend::good() const noexcept { return false; }
+
+    size_t UringBackend::pending() const noexcept { return completed.size(); }
+
+    ////////////////////////////////////////////////////////////////
+    // Writing.
+    ////////////////////////////////////////////////////////////////
+
+    void UringBackend::registerBuffers(std::span<const WriteSegment>) {}
+
+    void UringBackend::submit(uint64_t, const void*, size_t, const size_t tag) { completed.push_back(tag); }
+
+    void UringBackend::submit(uint64_t, std::span<WriteSegment>, const size_t tag) { completed.push_back(tag); }
+
+    size_t UringBackend::wait()
+    {
+        assert(!completed.empty());
+        const auto tag = completed.front();
+        completed.pop_front();
+        return tag;
+    }
+
+    std::optional<size_t> UringBackend::poll()
+    {
+        if (completed.empty()) return std::nullopt;
+        return wait();
+    }
+
+    uint32_t UringBackend::acquire() { return 0; }
+
+    void UringBackend::prepare(uint32_t) {}
+
+    bool UringBackend::reap(bool) { return false; }
+
+    void UringBackend::finish(uint32_t) {}
+
+    void UringBackend::complete(size_t, size_t) {}
+
+#endif
+}  // namespace lal
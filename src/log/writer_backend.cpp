@@ -0,0 +1,55 @@
+#include "logandload/log/writer_backend.h"
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+////////////////////////////////////////////////////////////////
+// Current target includes.
+////////////////////////////////////////////////////////////////
+
+#include "logandload/log/pwrite_backend.h"
+#include "logandload/log/uring_backend.h"
+
+namespace lal
+{
+    void IWriterBackend::registerBuffers(std::span<const WriteSegment>) {}
+
+#ifndef WIN32
+    int openLogFile(const std::filesystem::path& path, const bool direct)
+    {
+        auto flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+#ifdef O_DIRECT
+        if (direct) flags |= O_DIRECT;
+#endif
+
+        const auto fd = ::open(path.c_str(), flags, 0644);
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+        if (fd >= 0 && direct && ::fcntl(fd, F_NOCACHE, 1) < 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+#endif
+        return fd;
+    }
+#endif
+
+    IWriterBackendPtr createWriterBackend(const std::filesystem::path& path, const LogSettings& settings)
+    {
+        if (settings.writerBackend == WriterBackend::IoUring && UringBackend::supported())
+        {
+            auto backend = std::make_unique<UringBackend>(path, settings.queueDepth, settings.directIo);
+
+            // Fall back to pwrite if io_uring could not be initialized, e.g. on older kernels.
+            if (backend->good()) return backend;
+        }
+
+        return std::make_unique<PwriteBackend>(path, settings.directIo);
+    }
+}  // namespace lal
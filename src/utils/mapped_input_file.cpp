@@ -0,0 +1,98 @@
+#include "logandload/utils/mapped_input_file.h"
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <format>
+#include <fstream>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+////////////////////////////////////////////////////////////////
+// Current target includes.
+////////////////////////////////////////////////////////////////
+
+#include "logandload/utils/lal_error.h"
+
+namespace lal
+{
+#ifndef WIN32
+
+    ////////////////////////////////////////////////////////////////
+    // Constructors.
+    ////////////////////////////////////////////////////////////////
+
+    MappedInputFile::MappedInputFile(const std::filesystem::path& path)
+    {
+        const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw LalError(std::format("Failed to open file {}.", path.string()));
+
+        struct stat st = {};
+        if (::fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            throw LalError(std::format("Failed to open file {}.", path.string()));
+        }
+        size = static_cast<size_t>(st.st_size);
+
+        // Empty files cannot be mapped. The mapping keeps the file open.
+        if (size > 0)
+        {
+            auto* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED)
+            {
+                ::close(fd);
+                throw LalError(std::format("Failed to map file {}.", path.string()));
+            }
+            mapping = static_cast<std::byte*>(data);
+        }
+        ::close(fd);
+    }
+
+    MappedInputFile::~MappedInputFile() noexcept
+    {
+        if (mapping) ::munmap(mapping, size);
+    }
+
+    ////////////////////////////////////////////////////////////////
+    // Access hints.
+    ////////////////////////////////////////////////////////////////
+
+    void MappedInputFile::adviseSequential() const noexcept
+    {
+        if (mapping) ::madvise(mapping, size, MADV_SEQUENTIAL);
+    }
+
+#else
+
+    MappedInputFile::MappedInputFile(const std::filesystem::path& path)
+    {
+        auto file = std::ifstream(path, std::ios::binary | std::ios::ate);
+        if (!file) throw LalError(std::format("Failed to open file {}.", path.string()));
+
+        size = static_cast<size_t>(file.tellg());
+        file.seekg(0);
+        buffer.resize(size);
+        file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(size));
+        if (!file) throw LalError(std::format("Failed to read file {}.", path.string()));
+        mapping = buffer.data();
+    }
+
+    MappedInputFile::~MappedInputFile() noexcept = default;
+
+    void MappedInputFile::adviseSequential() const noexcept {}
+
+#endif
+
+    ////////////////////////////////////////////////////////////////
+    // Getters.
+    ////////////////////////////////////////////////////////////////
+
+    std::span<const std::byte> MappedInputFile::data() const noexcept { return {mapping, size}; }
+}  // namespace lal
@@ -0,0 +1,40 @@
+#include "logandload/utils/order.h"
+
+////////////////////////////////////////////////////////////////
+// Standard includes.
+////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+
+namespace lal
+{
+    std::vector<std::vector<uint64_t>> reconstructOrder(const std::vector<std::vector<uint64_t>>& timestamps)
+    {
+        std::vector<std::vector<uint64_t>> indices(timestamps.size());
+        for (size_t i = 0; i < timestamps.size(); i++) indices[i].resize(timestamps[i].size());
+
+        // Merge streams. Each entry is the sort key of the next message of a stream and the stream index. The key of a
+        // message is never less than that of its predecessor, so that a stream is always consumed in order.
+        using entry_t = std::pair<uint64_t, size_t>;
+        std::priority_queue<entry_t, std::vector<entry_t>, std::greater<>> queue;
+        std::vector<size_t>                                                 next(timestamps.size(), 0);
+        for (size_t i = 0; i < timestamps.size(); i++)
+            if (!timestamps[i].empty()) queue.emplace(timestamps[i].front(), i);
+
+        uint64_t index = 0;
+        while (!queue.empty())
+        {
+            const auto [key, stream] = queue.top();
+            queue.pop();
+
+            indices[stream][next[stream]++] = index++;
+            if (next[stream] < timestamps[stream].size())
+                queue.emplace(std::max(key, timestamps[stream][next[stream]]), stream);
+        }
+
+        return indices;
+    }
+}  // namespace lal